@@ -1,12 +1,16 @@
 #include "avl_tree.h"
 #include <stdlib.h>
 
-static NODE* _insert(AVL_TREE *tree, NODE* root, NODE* newPtr, int* taller, int *success);
-static NODE* _delete(AVL_TREE *tree, NODE* root, void *dltKey, int *shorter, int *success, int *freed);
-static void* _retrieve(AVL_TREE *tree, void *keyPtr, NODE *root);
-static void _traversal(NODE *root, void *paramInOut, void (*process)(void *dataPtr, void *paramInOut));
-static void _destroy(NODE *root, void (*dataFreeMemFunc)(void *dataPtr));
-static void _destroy_node_only(NODE* root);
+//Direction of a step recorded in a path stack
+#define _GO_LEFT  0
+#define _GO_RIGHT 1
+
+static void _destroy(AVL_TREE *tree, NODE *root, void (*dataFreeMemFunc)(void *dataPtr));
+static void _relink(AVL_TREE *tree, NODE **path, unsigned char *dir, int depth, NODE *root);
+
+static NODE* _allocNode(AVL_TREE *tree);
+static void _freeNode(AVL_TREE *tree, NODE *node);
+static void _destroyPool(AVL_TREE *tree);
 
 static NODE* rotateLeft(NODE *root);
 static NODE* rotateRight(NODE *root);
@@ -15,88 +19,109 @@ static NODE* insRightBal(NODE *root, int *taller);
 static NODE* dltLeftBal(NODE *root, int *shorter);
 static NODE* dltRightBal(NODE *root, int *shorter);
 
-static NODE* _copy(NODE *root, void* (*dup)(void *dataPtr) , void (*dlt)(void *dataPtr));
+static NODE* _copy(AVL_TREE *tree, NODE *root, void* (*dup)(void *dataPtr) , void (*dlt)(void *dataPtr));
+static NODE* _build(AVL_TREE *tree, void **dataArray, unsigned int count, int *height);
 
 AVL_TREE* AVL_Create(int (*compare)(void *arg1, void *arg2), void (*dataFreeMemFunc)(void *dataPtr)) {
+	return AVL_CreatePooled(compare, dataFreeMemFunc, 0u);
+}
+
+AVL_TREE* AVL_CreatePooled(int (*compare)(void *arg1, void *arg2), void (*dataFreeMemFunc)(void *dataPtr), unsigned int nodesPerBlock) {
 	AVL_TREE *tree = (AVL_TREE*)malloc(sizeof(AVL_TREE));
 	if(tree) {
 		tree->root = 0;
 		tree->count = 0u;
 		tree->compare = compare;
 		tree->dataFreeMemFunc = dataFreeMemFunc;
+		tree->poolBlockSize = nodesPerBlock;
+		tree->poolBlocks = 0;
+		tree->poolBlockCount = 0u;
+		tree->poolFreeList = 0;
 	}
 	return tree;
 }
 
 int AVL_Insert(AVL_TREE *tree, void *dataInPtr) {
-	NODE *newPtr = (NODE*)malloc(sizeof(NODE));
-	int forTaller = 0;
-	int success = 0;
+	NODE *path[AVL_MAX_HEIGHT];
+	unsigned char dir[AVL_MAX_HEIGHT];
+	NODE *root = tree->root;
+	NODE *newPtr;
+	int depth = 0;
+	int taller;
+	int c;
 	
+	//Walk down to the empty slot, remembering the path for rebalancing
+	while(root) {
+		c = tree->compare(dataInPtr, root->dataPtr);
+		if(c == 0) {
+			if(tree->dataFreeMemFunc) tree->dataFreeMemFunc(dataInPtr);
+			return 0;
+		}
+		path[depth] = root;
+		if(c < 0) {
+			dir[depth++] = _GO_LEFT;
+			root = root->left;
+		}
+		else {
+			dir[depth++] = _GO_RIGHT;
+			root = root->right;
+		}
+	}
+	
+	newPtr = _allocNode(tree);
 	if(!newPtr) return 0;
 	
 	newPtr->bal = EH;
 	newPtr->right = 0;
 	newPtr->left = 0;
 	newPtr->dataPtr = dataInPtr;
+	_relink(tree, path, dir, depth, newPtr);
+	(tree->count) += 1;
 	
-	tree->root = _insert(tree, tree->root, newPtr, &forTaller, &success);
-	if(success) (tree->count) += 1;
-	else {
-		if(tree->dataFreeMemFunc) tree->dataFreeMemFunc(newPtr->dataPtr);
-		free(newPtr);
-	}
-	return success;
-}
-
-static NODE* _insert(AVL_TREE *tree, NODE* root, NODE* newPtr, int* taller, int *success) {
-	if(!root) {
-		root = newPtr;
-		*taller = 1;
-		*success = 1;
-		return root;
-	}
-	
-	if(tree->compare(newPtr->dataPtr, root->dataPtr) < 0) {
-		root->left = _insert(tree, root->left, newPtr, taller, success);
-		if(!(*success)) return root;
-		if(*taller) {
+	//Walk back up while the subtree we came from grew taller
+	taller = 1;
+	while(taller && depth > 0) {
+		depth -= 1;
+		root = path[depth];
+		if(dir[depth] == _GO_LEFT) {
 			switch(root->bal) {
 				case LH:
-					root = insLeftBal(root, taller);
+					root = insLeftBal(root, &taller);
 					break;
 				case EH:
 					root->bal = LH;
 					break;
 				case RH:
 					root->bal = EH;
-					*taller = 0;
+					taller = 0;
 					break;
 				default: abort();
 			}
 		}
-	}
-	else if(tree->compare(newPtr->dataPtr, root->dataPtr) > 0) {
-		root->right = _insert(tree, root->right, newPtr, taller, success);
-		if(!(*success)) return root;
-		if(*taller) {
+		else {
 			switch(root->bal) {
 				case LH:
 					root->bal = EH;
-					*taller = 0;
+					taller = 0;
 					break;
 				case EH:
 					root->bal = RH;
 					break;
 				case RH:
-					root = insRightBal(root, taller);
+					root = insRightBal(root, &taller);
 					break;
 				default: abort();
 			}
 		}
+		_relink(tree, path, dir, depth, root);
 	}
-	else *success = 0;
-	return root;
+	return 1;
+}
+
+static void _relink(AVL_TREE *tree, NODE **path, unsigned char *dir, int depth, NODE *root) {
+	if(depth == 0) tree->root = root;
+	else if(dir[depth - 1] == _GO_LEFT) path[depth - 1]->left = root;
+	else path[depth - 1]->right = root;
 }
 
 static NODE* rotateLeft(NODE *root) {
@@ -200,84 +225,58 @@ static NODE* insRightBal(NODE *root, int *taller) {
 }
 
 int AVL_Delete(AVL_TREE *tree, void *dltKey) {
-	int shorter = 0;
-	int success = 0;
-	int freed = 0;
-	NODE *newRoot = _delete(tree, tree->root, dltKey, &shorter, &success, &freed);
-	
-	if(success) {
-		tree->root = newRoot;
-		(tree->count) -= 1;
-	}
-	return success;
-}
-
-static NODE *_delete(AVL_TREE *tree, NODE *root, void *dltKey, int *shorter, int *success, int *freed) {
+	NODE *path[AVL_MAX_HEIGHT];
+	unsigned char dir[AVL_MAX_HEIGHT];
+	NODE *root = tree->root;
 	NODE *dltPtr;
 	NODE *exchPtr;
-	NODE *newRoot;
+	int depth = 0;
+	int shorter;
+	int c;
 	
-	if(!root) {
-		*shorter = 0;
-		*success = 0;
-		return 0;
-	}
-	
-	if(tree->compare(dltKey, root->dataPtr) < 0) {
-		root->left = _delete(tree, root->left, dltKey, shorter, success, freed);
-		if(*shorter)
-			root = dltRightBal(root, shorter);
-	}
-	else if(tree->compare(dltKey, root->dataPtr) > 0) {
-		root->right = _delete(tree, root->right, dltKey, shorter, success, freed);
-		if(*shorter)
-			root = dltLeftBal(root, shorter);
-	}
-	else {
-		dltPtr = root;
-		if(!root->right) {
-			newRoot = root->left;
-			*success = 1;
-			*shorter = 1;
-			if(tree->dataFreeMemFunc) {
-				if(!*freed) {
-					tree->dataFreeMemFunc(dltPtr->dataPtr);
-					*freed = 1;
-				}
-			}
-			free(dltPtr);
-			return newRoot;
-		}
-		else if(!root->left) {
-			newRoot = root->right;
-			*success = 1;
-			*shorter = 1;
-			if(tree->dataFreeMemFunc) {
-				if(!*freed) {
-					tree->dataFreeMemFunc(dltPtr->dataPtr);
-					*freed = 1;
-				}
-			}
-			free(dltPtr);
-			return newRoot;
+	while(root) {
+		c = tree->compare(dltKey, root->dataPtr);
+		if(c == 0) break;
+		path[depth] = root;
+		if(c < 0) {
+			dir[depth++] = _GO_LEFT;
+			root = root->left;
 		}
 		else {
-			exchPtr = root->left;
-			while(exchPtr->right)
-				exchPtr = exchPtr->right;
-			if(tree->dataFreeMemFunc) {
-				if(!*freed) {
-					tree->dataFreeMemFunc(dltPtr->dataPtr);
-					*freed = 1;
-				}
-			}
-			root->dataPtr = exchPtr->dataPtr;
-			root->left = _delete(tree, root->left, exchPtr->dataPtr, shorter, success, freed);
-			if(*shorter)
-				root = dltRightBal(root, shorter);
+			dir[depth++] = _GO_RIGHT;
+			root = root->right;
 		}
 	}
-	return root;
+	if(!root) return 0;
+	
+	if(tree->dataFreeMemFunc) tree->dataFreeMemFunc(root->dataPtr);
+	dltPtr = root;
+	if(root->left && root->right) {
+		//Replace the data by its in-order predecessor, then unlink the predecessor node instead
+		path[depth] = root;
+		dir[depth++] = _GO_LEFT;
+		exchPtr = root->left;
+		while(exchPtr->right) {
+			path[depth] = exchPtr;
+			dir[depth++] = _GO_RIGHT;
+			exchPtr = exchPtr->right;
+		}
+		root->dataPtr = exchPtr->dataPtr;
+		dltPtr = exchPtr;
+	}
+	_relink(tree, path, dir, depth, dltPtr->left ? dltPtr->left : dltPtr->right);
+	_freeNode(tree, dltPtr);
+	(tree->count) -= 1;
+	
+	//Walk back up while the subtree we came from got shorter
+	shorter = 1;
+	while(shorter && depth > 0) {
+		depth -= 1;
+		if(dir[depth] == _GO_LEFT) root = dltRightBal(path[depth], &shorter);
+		else root = dltLeftBal(path[depth], &shorter);
+		_relink(tree, path, dir, depth, root);
+	}
+	return 1;
 }
 
 static NODE* dltLeftBal(NODE *root, int *shorter) {
@@ -399,34 +398,74 @@ static NODE* dltRightBal(NODE *root, int *shorter) {
 }
 
 void* AVL_Retrieve(AVL_TREE *tree, void *keyPtr) {
-	if(tree->root)
-		return _retrieve(tree, keyPtr, tree->root);
-	else return 0;
-}
-
-static void* _retrieve(AVL_TREE *tree, void *keyPtr, NODE *root) {
-	if(root) {
-		if(tree->compare(keyPtr, root->dataPtr) < 0)
-			return _retrieve(tree, keyPtr, root->left);
-		else if(tree->compare(keyPtr, root->dataPtr) > 0)
-			return _retrieve(tree, keyPtr, root->right);
+	NODE *root = tree->root;
+	int c;
+	
+	while(root) {
+		c = tree->compare(keyPtr, root->dataPtr);
+		if(c < 0) root = root->left;
+		else if(c > 0) root = root->right;
 		else return root->dataPtr;
 	}
-	else return 0;
+	return 0;
 }
 
 void AVL_Traverse(AVL_TREE *tree, void *paramInOut, void (*process)(void *dataPtr, void *paramInOut)) {
-	_traversal(tree->root, paramInOut, process);
+	NODE *stack[AVL_MAX_HEIGHT];
+	NODE *root = tree->root;
+	int depth = 0;
+	
+	while(root || depth > 0) {
+		while(root) {
+			stack[depth++] = root;
+			root = root->left;
+		}
+		root = stack[--depth];
+		process(root->dataPtr, paramInOut);
+		root = root->right;
+	}
 	return ;
 }
 
-static void _traversal(NODE *root, void *paramInOut, void (*process)(void *dataPtr, void *paramInOut)) {
-	if(root) {
-		_traversal(root->left, paramInOut, process);
-		process(root->dataPtr, paramInOut);
-		_traversal(root->right, paramInOut, process);
+void* AVL_First(AVL_TREE *tree, AVL_ITERATOR *it) {
+	NODE *root = tree->root;
+	
+	it->depth = 0;
+	while(root) {
+		it->stack[(it->depth)++] = root;
+		root = root->left;
 	}
-	return ;
+	return (it->depth > 0) ? it->stack[it->depth - 1]->dataPtr : 0;
+}
+
+void* AVL_LowerBound(AVL_TREE *tree, AVL_ITERATOR *it, void *keyPtr) {
+	NODE *root = tree->root;
+	int c;
+	
+	//Only the nodes we go left from are not less than the key
+	it->depth = 0;
+	while(root) {
+		c = tree->compare(keyPtr, root->dataPtr);
+		if(c <= 0) {
+			it->stack[(it->depth)++] = root;
+			if(c == 0) break;
+			root = root->left;
+		}
+		else root = root->right;
+	}
+	return (it->depth > 0) ? it->stack[it->depth - 1]->dataPtr : 0;
+}
+
+void* AVL_Next(AVL_ITERATOR *it) {
+	NODE *root;
+	
+	if(it->depth == 0) return 0;
+	root = it->stack[--(it->depth)]->right;
+	while(root) {
+		it->stack[(it->depth)++] = root;
+		root = root->left;
+	}
+	return (it->depth > 0) ? it->stack[it->depth - 1]->dataPtr : 0;
 }
 
 int AVL_Empty(AVL_TREE *tree) {
@@ -446,33 +485,115 @@ unsigned int AVL_Count(AVL_TREE *tree) {
 	return tree->count;
 }
 
+void AVL_Clear(AVL_TREE *tree) {
+	NODE_BLOCK *next;
+	
+	if(!(tree->poolBlockSize)) _destroy(tree, tree->root, 0);
+	else if(tree->poolBlocks) {
+		while((next = tree->poolBlocks->next)) {
+			free(tree->poolBlocks);
+			tree->poolBlocks = next;
+		}
+		tree->poolBlocks->used = 0u;
+		tree->poolBlockCount = 1u;
+		tree->poolFreeList = 0;
+	}
+	tree->root = 0;
+	tree->count = 0u;
+	return ;
+}
+
+size_t AVL_MemoryUsage(AVL_TREE *tree) {
+	if(tree->poolBlockSize)
+		return sizeof(AVL_TREE) + tree->poolBlockCount * (sizeof(NODE_BLOCK) + sizeof(NODE) * tree->poolBlockSize);
+	return sizeof(AVL_TREE) + tree->count * sizeof(NODE);
+}
+
 AVL_TREE* AVL_Destroy(AVL_TREE *tree) {
 	if(tree) {
-		if(tree->dataFreeMemFunc) _destroy(tree->root, tree->dataFreeMemFunc);
-		else _destroy_node_only(tree->root);
+		if(tree->poolBlockSize) _destroyPool(tree);
+		else _destroy(tree, tree->root, tree->dataFreeMemFunc);
 	}
 	
 	free(tree);
 	return 0;
 }
 
-static void _destroy(NODE *root, void (*dataFreeMemFunc)(void *dataPtr)) {
-	if(root) {
-		_destroy(root->left, dataFreeMemFunc);
-		dataFreeMemFunc(root->dataPtr);
-		_destroy(root->right, dataFreeMemFunc);
-		free(root);
+static void _destroy(AVL_TREE *tree, NODE *root, void (*dataFreeMemFunc)(void *dataPtr)) {
+	NODE *tempPtr;
+	
+	//Rotate left children up until the root has none, so no stack is needed
+	while(root) {
+		if(root->left) {
+			tempPtr = root->left;
+			root->left = tempPtr->right;
+			tempPtr->right = root;
+			root = tempPtr;
+		}
+		else {
+			tempPtr = root->right;
+			if(dataFreeMemFunc) dataFreeMemFunc(root->dataPtr);
+			_freeNode(tree, root);
+			root = tempPtr;
+		}
 	}
 	return ;
 }
 
-static void _destroy_node_only(NODE *root) {
-	if(root) {
-		_destroy_node_only(root->left);
-		_destroy_node_only(root->right);
-		free(root);
+static NODE* _allocNode(AVL_TREE *tree) {
+	NODE_BLOCK *block;
+	NODE *node;
+	
+	if(!(tree->poolBlockSize)) return (NODE*)malloc(sizeof(NODE));
+	
+	if(tree->poolFreeList) {
+		node = tree->poolFreeList;
+		tree->poolFreeList = node->left;
+		return node;
 	}
-	return ;
+	
+	block = tree->poolBlocks;
+	if(!block || block->used == tree->poolBlockSize) {
+		block = (NODE_BLOCK*)malloc(sizeof(NODE_BLOCK) + sizeof(NODE) * tree->poolBlockSize);
+		if(!block) return 0;
+		block->used = 0u;
+		block->next = tree->poolBlocks;
+		tree->poolBlocks = block;
+		tree->poolBlockCount += 1u;
+	}
+	return block->nodes + (block->used)++;
+}
+
+static void _freeNode(AVL_TREE *tree, NODE *node) {
+	if(!(tree->poolBlockSize)) {
+		free(node);
+		return ;
+	}
+	
+	//A released pool node is marked by a null data pointer so _destroyPool can skip it
+	node->dataPtr = 0;
+	node->left = tree->poolFreeList;
+	tree->poolFreeList = node;
+}
+
+static void _destroyPool(AVL_TREE *tree) {
+	NODE_BLOCK *block;
+	NODE_BLOCK *next;
+	unsigned int i;
+	
+	for(block = tree->poolBlocks; block; block = next) {
+		next = block->next;
+		if(tree->dataFreeMemFunc) {
+			for(i = 0; i < block->used; i += 1)
+				if(block->nodes[i].dataPtr) tree->dataFreeMemFunc(block->nodes[i].dataPtr);
+		}
+		free(block);
+	}
+	tree->poolBlocks = 0;
+	tree->poolBlockCount = 0u;
+	tree->poolFreeList = 0;
+	tree->root = 0;
+	tree->count = 0u;
 }
 
 _treeCmpFuncT AVL_CompareFunc(AVL_TREE *tree) {
@@ -483,42 +604,177 @@ _treeDataFreeMemFunc AVL_MemFreeFunc(AVL_TREE *tree) {
 	return tree->dataFreeMemFunc;
 }
 
-static NODE* _copy(NODE *root, void* (*dup)(void *dataPtr) , void (*dlt)(void *dataPtr)) {
-	NODE *ret = (NODE*)malloc(sizeof(NODE));
-	if(!ret) return 0;
-	ret->dataPtr = dup(root->dataPtr);
-	if(!(ret->dataPtr)) {
-		free(ret);
-		return 0;
-	}
-	ret->left = _copy(root->left, dup, dlt);
-	if(!(ret->left)) {
-		dlt(ret->dataPtr);
-		free(ret);
-		return 0;
-	}
-	ret->right = _copy(root->right, dup, dlt);
-	if(!(ret->right)) {
-		if(dlt) _destroy(ret->left, dlt);
-		else _destroy_node_only(ret->left);
-		dlt(ret->dataPtr);
-		free(ret);
-		return 0;
+static NODE* _copy(AVL_TREE *tree, NODE *root, void* (*dup)(void *dataPtr) , void (*dlt)(void *dataPtr)) {
+	NODE *srcStack[AVL_MAX_HEIGHT * 2];
+	NODE *dstStack[AVL_MAX_HEIGHT * 2];
+	NODE **child[2];
+	NODE *src[2];
+	NODE *ret = 0;
+	NODE *p;
+	NODE *q;
+	int depth = 0;
+	int i;
+	
+	//Pre-order walk; every copied node is linked in before its children are copied
+	srcStack[depth] = root;
+	dstStack[depth++] = 0;
+	while(depth > 0) {
+		depth -= 1;
+		p = srcStack[depth];
+		q = _allocNode(tree);
+		if(!q) goto _copy_failure;
+		q->dataPtr = dup(p->dataPtr);
+		if(!(q->dataPtr)) {
+			_freeNode(tree, q);
+			goto _copy_failure;
+		}
+		q->left = 0;
+		q->right = 0;
+		q->bal = p->bal;
+		if(!dstStack[depth]) ret = q;
+		else if(dstStack[depth]->left == dstStack[depth]) dstStack[depth]->left = q;
+		else dstStack[depth]->right = q;
+		
+		//A pending child slot is marked by pointing it at its own parent
+		child[0] = &(q->right);
+		child[1] = &(q->left);
+		src[0] = p->right;
+		src[1] = p->left;
+		for(i = 0; i < 2; i += 1) {
+			if(src[i]) {
+				*(child[i]) = q;
+				srcStack[depth] = src[i];
+				dstStack[depth++] = q;
+			}
+		}
 	}
-	ret->bal = root->bal;
 	return ret;
+
+_copy_failure:
+	//Clear the slots that were still pending, including the failed one, then release what was copied
+	depth += 1;
+	while(depth > 0) {
+		depth -= 1;
+		if(!dstStack[depth]) continue;
+		if(dstStack[depth]->left == dstStack[depth]) dstStack[depth]->left = 0;
+		if(dstStack[depth]->right == dstStack[depth]) dstStack[depth]->right = 0;
+	}
+	_destroy(tree, ret, dlt);
+	return 0;
 }
 
 AVL_TREE* AVL_Copy(AVL_TREE *tree, void* (*dup)(void *dataPtr)) {
-	AVL_TREE *ret = (AVL_TREE*)malloc(sizeof(AVL_TREE));
+	AVL_TREE *ret = AVL_CreatePooled(tree->compare, tree->dataFreeMemFunc, tree->poolBlockSize);
 	if(!ret) return 0;
-	ret->root = _copy(tree->root, dup, tree->dataFreeMemFunc);
-	if(!(ret->root)) {
-		free(ret);
+	if(tree->root) ret->root = _copy(ret, tree->root, dup, tree->dataFreeMemFunc);
+	if(tree->root && !(ret->root)) {
+		AVL_Destroy(ret);
 		return 0;
 	}
-	ret->compare = tree->compare;
 	ret->count = tree->count;
-	ret->dataFreeMemFunc = tree->dataFreeMemFunc;
 	return ret;
 }
+
+int AVL_BuildSorted(AVL_TREE *tree, void **dataArray, unsigned int count) {
+	NODE *root;
+	int height;
+	
+	if(tree->root) return 0;
+	if(count == 0) return 1;
+	root = _build(tree, dataArray, count, &height);
+	if(!root) return 0;
+	tree->root = root;
+	tree->count = count;
+	return 1;
+}
+
+static NODE* _build(AVL_TREE *tree, void **dataArray, unsigned int count, int *height) {
+	NODE *root;
+	unsigned int mid = count / 2;
+	int leftHeight = 0;
+	int rightHeight = 0;
+	
+	//The left half is never smaller than the right one, so bal is EH or LH; recursion depth is log2(count)
+	root = _allocNode(tree);
+	if(!root) return 0;
+	root->dataPtr = dataArray[mid];
+	root->left = 0;
+	root->right = 0;
+	if(mid > 0) {
+		root->left = _build(tree, dataArray, mid, &leftHeight);
+		if(!(root->left)) goto _build_failure;
+	}
+	if(count - mid - 1 > 0) {
+		root->right = _build(tree, dataArray + mid + 1, count - mid - 1, &rightHeight);
+		if(!(root->right)) goto _build_failure;
+	}
+	root->bal = leftHeight - rightHeight;
+	*height = 1 + leftHeight;
+	return root;
+
+_build_failure:
+	_destroy(tree, root, 0);
+	return 0;
+}
+
+AVL_FROZEN* AVL_Freeze(AVL_TREE *tree) {
+	NODE *stack[AVL_MAX_HEIGHT];
+	NODE *root = tree->root;
+	AVL_FROZEN *frozen;
+	unsigned int n = tree->count;
+	unsigned int k;
+	int depth = 0;
+	
+	frozen = (AVL_FROZEN*)malloc(sizeof(AVL_FROZEN));
+	if(!frozen) return 0;
+	frozen->data = (void**)malloc(sizeof(void*) * (n + 1));
+	if(!(frozen->data)) {
+		free(frozen);
+		return 0;
+	}
+	frozen->compare = tree->compare;
+	frozen->count = n;
+	frozen->data[0] = 0;
+	if(n == 0) return frozen;
+	
+	//Walk the tree in order and the implicit layout in order at the same time
+	k = 1;
+	while(2 * k <= n) k *= 2;
+	while(root || depth > 0) {
+		while(root) {
+			stack[depth++] = root;
+			root = root->left;
+		}
+		root = stack[--depth];
+		frozen->data[k] = root->dataPtr;
+		root = root->right;
+		
+		if(2 * k + 1 <= n) {
+			k = 2 * k + 1;
+			while(2 * k <= n) k *= 2;
+		}
+		else {
+			while(k & 1) k >>= 1;
+			k >>= 1;
+		}
+	}
+	return frozen;
+}
+
+void* AVL_FrozenRetrieve(AVL_FROZEN *frozen, void *keyPtr) {
+	unsigned int k = 1;
+	int c;
+	
+	while(k <= frozen->count) {
+		c = frozen->compare(keyPtr, frozen->data[k]);
+		if(c == 0) return frozen->data[k];
+		k = 2 * k + (c > 0);
+	}
+	return 0;
+}
+
+AVL_FROZEN* AVL_FrozenDestroy(AVL_FROZEN *frozen) {
+	if(frozen) free(frozen->data);
+	free(frozen);
+	return 0;
+}
@@ -1,10 +1,15 @@
 #ifndef AVL_H_LOADED
 #define AVL_H_LOADED
 
+#include <string.h>
+
 #define LH +1
 #define EH  0
 #define RH -1
 
+//Upper bound of the height of any AVL tree that fits in memory, sizes the path stacks
+#define AVL_MAX_HEIGHT 64
+
 //Structure Declarations
 
 //Compare function
@@ -25,14 +30,39 @@ typedef struct node
 	int 		 bal;		// Balance number, height of left tree - height of right tree
 } NODE ;
 
+//Node pool block, nodes are carved from it in order
+typedef struct nodeBlock
+{
+	struct nodeBlock *next;	// Next (older) block in the pool
+	unsigned int used;		// Number of nodes carved from this block
+	NODE nodes[];			// Node storage, poolBlockSize entries
+} NODE_BLOCK ;
+
 //Tree head
 typedef struct {
 	_treeCmpFuncT compare;	//Data comparison function
 	_treeDataFreeMemFunc dataFreeMemFunc;	//Data memory release function
 	NODE *root;								//Tree root node pointer
 	unsigned int count;						//Number of nodes
+	unsigned int poolBlockSize;				//Nodes per pool block, 0 when nodes are malloc'ed one by one
+	NODE_BLOCK *poolBlocks;					//Pool blocks, newest first
+	unsigned int poolBlockCount;			//Number of pool blocks
+	NODE *poolFreeList;						//Pool nodes released by deletion, linked by left pointer
 } AVL_TREE ;
 
+//In-order cursor, holds the nodes still to be visited with the current one on top
+typedef struct {
+	NODE *stack[AVL_MAX_HEIGHT];	//Pending nodes, stack[depth - 1] is the current one
+	int depth;						//Number of pending nodes, 0 when exhausted
+} AVL_ITERATOR ;
+
+//Read-only snapshot of a tree, data pointers stored in Eytzinger (breadth-first) order
+typedef struct {
+	_treeCmpFuncT compare;	//Data comparison function
+	void **data;			//data[1..count], children of data[k] are data[2k] and data[2k+1]
+	unsigned int count;		//Number of data pointers
+} AVL_FROZEN ;
+
 
 //Prototype Declarations
 
@@ -57,6 +87,29 @@ typedef struct {
 */
 AVL_TREE* AVL_Create(int (*compare)(void *arg1, void *arg2), void (*dataFreeMemFunc)(void *dataPtr));
 
+/*AVL_CreatePooled
+  Description:
+    Create a tree head whose nodes are carved from a pool of contiguous blocks
+    instead of being malloc'ed one by one.
+    Destroying such a tree releases the nodes in O(blocks).
+
+  Input:
+    int (*compare)(void *arg1, void *arg2)
+      [Required] Data comparison function, see AVL_Create.
+
+    void (*dataFreeMemFunc)(void *dataPtr)
+      [Optional] Data memory release function, see AVL_Create.
+
+    unsigned int nodesPerBlock
+      [Optional] Number of nodes in each pool block.
+        If it is 0, the pool is disabled and this is the same as AVL_Create.
+
+  Output:
+    Returns NULL when memory not available.
+    Else returns a tree heads.
+*/
+AVL_TREE* AVL_CreatePooled(int (*compare)(void *arg1, void *arg2), void (*dataFreeMemFunc)(void *dataPtr), unsigned int nodesPerBlock);
+
 /*AVL_Destroy
   Description:
     Destroy a tree head.
@@ -121,6 +174,151 @@ int AVL_Delete(AVL_TREE *tree, void *dltKey);
 */
 void* AVL_Retrieve(AVL_TREE *tree, void *keyPtr);
 
+/*AVL_BuildSorted
+  Description:
+    Build a balanced tree from pre-sorted data in O(n) without rotations.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] An empty tree head.
+
+    void **dataArray
+      [Required] Data pointers in strictly increasing order according to the comparison function.
+
+    unsigned int count
+      [Required] Number of data pointers in dataArray.
+  
+  Output:
+    Returns 0 when the tree is not empty or memory not available,
+      the data pointers are then left to the caller.
+    Returns 1 on success
+*/
+int AVL_BuildSorted(AVL_TREE *tree, void **dataArray, unsigned int count);
+
+/*AVL_Freeze
+  Description:
+    Create a read-only snapshot of a tree laid out for cache-friendly search.
+    The snapshot shares the data pointers with the tree, so it must be destroyed
+    before the data are released. Later changes to the tree are not reflected.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] A tree head.
+  
+  Output:
+    Returns NULL when memory not available.
+    Else returns a snapshot.
+*/
+AVL_FROZEN* AVL_Freeze(AVL_TREE *tree);
+
+/*AVL_FrozenRetrieve
+  Description:
+    Retrieve a data pointer from a snapshot, see AVL_Retrieve.
+    
+  Input:
+    AVL_FROZEN *frozen
+      [Required] A snapshot.
+
+    void *keyPtr
+      [Required] A data pointer that is going to be retrieved.
+  
+  Output:
+    Returns 0 when the provided data is not found.
+    Returns the data pointer when found.
+*/
+void* AVL_FrozenRetrieve(AVL_FROZEN *frozen, void *keyPtr);
+
+/*AVL_FrozenDestroy
+  Description:
+    Destroy a snapshot. The data pointers are not handled.
+    
+  Input:
+    AVL_FROZEN *frozen
+      [Required] A snapshot to be destroyed.
+  
+  Output:
+    Returns NULL.
+*/
+AVL_FROZEN* AVL_FrozenDestroy(AVL_FROZEN *frozen);
+
+/*AVL_DEFINE_RETRIEVE
+  Description:
+    Generate a typed retrieval function which behaves like AVL_Retrieve
+    but compares with an inlinable expression instead of calling tree->compare.
+    
+  Input:
+    name
+      [Required] Name of the generated static function.
+
+    keyType
+      [Required] Type of the key argument of the generated function.
+
+    cmp
+      [Required] Function or function-like macro cmp(key, dataPtr),
+        returning the same sign as tree->compare would.
+  
+  Output:
+    Defines static void* name(AVL_TREE *tree, keyType key).
+*/
+#define AVL_DEFINE_RETRIEVE(name, keyType, cmp) \
+static void* name(AVL_TREE *tree, keyType key) { \
+	NODE *root = tree->root; \
+	int c; \
+	while(root) { \
+		c = cmp(key, root->dataPtr); \
+		if(c < 0) root = root->left; \
+		else if(c > 0) root = root->right; \
+		else return root->dataPtr; \
+	} \
+	return 0; \
+}
+
+/*AVL_DEFINE_FROZEN_RETRIEVE
+  Description:
+    Generate a typed retrieval function which behaves like AVL_FrozenRetrieve,
+    see AVL_DEFINE_RETRIEVE.
+  
+  Output:
+    Defines static void* name(AVL_FROZEN *frozen, keyType key).
+*/
+#define AVL_DEFINE_FROZEN_RETRIEVE(name, keyType, cmp) \
+static void* name(AVL_FROZEN *frozen, keyType key) { \
+	unsigned int k = 1; \
+	int c; \
+	while(k <= frozen->count) { \
+		c = cmp(key, frozen->data[k]); \
+		if(c == 0) return frozen->data[k]; \
+		k = 2 * k + (c > 0); \
+	} \
+	return 0; \
+}
+
+/*AVL_DEFINE_STRING_RETRIEVE
+  Description:
+    Generate a typed retrieval function for trees whose data are structures
+    ordered by strcmp on a string member.
+    
+  Input:
+    name
+      [Required] Name of the generated static function.
+
+    dataType
+      [Required] Type of the structures the data pointers point to.
+
+    member
+      [Required] Name of the string member used as key.
+  
+  Output:
+    Defines static void* name(AVL_TREE *tree, const char *key),
+    and its comparison static int name##_cmp(const char *key, void *dataPtr)
+    which can be handed to AVL_DEFINE_FROZEN_RETRIEVE.
+*/
+#define AVL_DEFINE_STRING_RETRIEVE(name, dataType, member) \
+static inline int name##_cmp(const char *key, void *dataPtr) { \
+	return strcmp(key, ((dataType*)dataPtr)->member); \
+} \
+AVL_DEFINE_RETRIEVE(name, const char*, name##_cmp)
+
 /*AVL_Traverse
   Description:
     Traverse a tree.
@@ -136,6 +334,59 @@ void* AVL_Retrieve(AVL_TREE *tree, void *keyPtr);
 */
 void AVL_Traverse(AVL_TREE *tree, void *paramInOut, void (*process)(void *dataPtr, void *paramInOut));
 
+/*AVL_First
+  Description:
+    Position a cursor on the smallest data of a tree.
+    The tree must not be modified while the cursor is in use.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] A tree head.
+
+    AVL_ITERATOR *it
+      [Required] A cursor to be positioned, usually allocated on the stack.
+  
+  Output:
+    Returns 0 when the tree is empty.
+    Returns the smallest data pointer.
+*/
+void* AVL_First(AVL_TREE *tree, AVL_ITERATOR *it);
+
+/*AVL_LowerBound
+  Description:
+    Position a cursor on the smallest data not less than a key.
+    The tree must not be modified while the cursor is in use.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] A tree head.
+
+    AVL_ITERATOR *it
+      [Required] A cursor to be positioned.
+
+    void *keyPtr
+      [Required] A data pointer used as the lower bound.
+  
+  Output:
+    Returns 0 when every data is less than the key.
+    Returns the first data pointer not less than the key.
+*/
+void* AVL_LowerBound(AVL_TREE *tree, AVL_ITERATOR *it, void *keyPtr);
+
+/*AVL_Next
+  Description:
+    Advance a cursor to the next data in order.
+    
+  Input:
+    AVL_ITERATOR *it
+      [Required] A cursor positioned by AVL_First or AVL_LowerBound.
+  
+  Output:
+    Returns 0 when there is no more data.
+    Returns the next data pointer.
+*/
+void* AVL_Next(AVL_ITERATOR *it);
+
 /*AVL_Count
   Description:
     Returns the number of data nodes in a tree.
@@ -149,6 +400,33 @@ void AVL_Traverse(AVL_TREE *tree, void *paramInOut, void (*process)(void *dataPt
 */
 unsigned int AVL_Count(AVL_TREE *tree);
 
+/*AVL_Clear
+  Description:
+    Remove every node from a tree, the data are not released.
+    A pooled tree keeps its oldest block, later inserts carve nodes from it again.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] A tree head.
+
+  Output: No Output
+*/
+void AVL_Clear(AVL_TREE *tree);
+
+/*AVL_MemoryUsage
+  Description:
+    Returns the bytes held by a tree head and its nodes, data not included.
+    Pool blocks count in full, including nodes not carved yet.
+    
+  Input:
+    AVL_TREE *tree
+      [Required] A tree head.
+
+  Output:
+    Return the number of bytes
+*/
+size_t AVL_MemoryUsage(AVL_TREE *tree);
+
 /*AVL_Empty
   Description:
     Check whether a tree is empty or not.
@@ -214,7 +492,7 @@ _treeDataFreeMemFunc AVL_MemFreeFunc(AVL_TREE *tree);
       [Required] Function for duplicating data
 
   Output:
-    Returns a copy of the tree.
+    Returns a copy of the tree, using the same pool settings as the tree.
     Returns NULL when memory overflows.
 */
 AVL_TREE* AVL_Copy(AVL_TREE *tree, void* (*dup)(void *dataPtr));
@@ -0,0 +1,418 @@
+/*
+    Microbenchmarks for the hot functions of each module, linked against the same
+    objects as the assembler.
+
+    Usage: bench [corpus.asm] [repetitions]
+
+    Every benchmark runs the given number of repetitions (15 by default) and reports
+    the mean ns/op, the standard deviation and the fastest repetition. The parser
+    functions are timed over the corpus; commandType(), symbol(), dest(), comp() and
+    jump() are reported as the extra time they add to a pass over the same lines.
+    The other inputs are drawn with fixed seeds from distributions that follow
+    VM translator output.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "../avl_tree.h"
+#include "../code.h"
+#include "../parser.h"
+#include "../symboltable.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _BENCH_DEFAULT_REPETITIONS 15
+#define _BENCH_MAX_REPETITIONS 1000
+#define _BENCH_CALLS 1000000
+#define _BENCH_SYMBOLS 4096
+#define _BENCH_SYMBOL_LENGTH 16
+
+// Parser functions timed on top of advance() + commandType(), the base pass
+#define _BENCH_PARSER_NONE 0
+#define _BENCH_PARSER_BASE 1
+#define _BENCH_PARSER_COMMAND_TYPE 2
+#define _BENCH_PARSER_SYMBOL 3
+#define _BENCH_PARSER_DEST 4
+#define _BENCH_PARSER_COMP 5
+#define _BENCH_PARSER_JUMP 6
+#define _BENCH_PARSER_REPEAT 16
+
+typedef double (*BenchRun_t)(void);
+
+typedef struct
+{
+    const char *name;
+    BenchRun_t run; // One repetition, returns ns/op
+} Bench_t;
+
+static const char *_benchCorpus = "bench/corpus.asm";
+static unsigned int _benchState = 2463534242u;
+static volatile unsigned int _benchSink;
+
+static const char *_benchComp[_BENCH_CALLS / 1000];
+static const char *_benchDest[_BENCH_CALLS / 1000];
+static const char *_benchJump[_BENCH_CALLS / 1000];
+static int _benchValues[_BENCH_CALLS / 1000];
+static char _benchSymbols[_BENCH_SYMBOLS][_BENCH_SYMBOL_LENGTH];
+static int _benchKeys[_BENCH_SYMBOLS];
+
+static unsigned int _BenchRandom(void)
+{
+    _benchState ^= _benchState << 13;
+    _benchState ^= _benchState >> 17;
+    _benchState ^= _benchState << 5;
+    return _benchState;
+}
+
+static double _BenchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// ================================
+
+/* Mnemonics and values weighted the way translated VM code uses them. */
+static void _BenchPrepare(void)
+{
+    static const char *comp[] = {"M", "D", "A", "M+1", "M-1", "D+M", "M-D", "D-1", "0", "-1", "D|M", "D&M", "!M", "-M", "D+A"};
+    static const unsigned int compWeight[] = {30, 20, 12, 8, 8, 5, 4, 3, 3, 2, 1, 1, 1, 1, 1};
+    static const char *dest[] = {"M", "D", "A", "AM", "MD", "AD", "AMD"};
+    static const unsigned int destWeight[] = {40, 35, 15, 6, 2, 1, 1};
+    static const char *jump[] = {"JMP", "JEQ", "JNE", "JGT", "JLT", "JGE", "JLE"};
+    static const unsigned int jumpWeight[] = {40, 20, 15, 10, 10, 3, 2};
+    unsigned int i, j, pick, total;
+
+    for (i = 0; i < sizeof(_benchComp) / sizeof(_benchComp[0]); i += 1)
+    {
+        for (j = 0, total = 0; j < sizeof(compWeight) / sizeof(compWeight[0]); j += 1)
+            total += compWeight[j];
+        for (j = 0, pick = _BenchRandom() % total; pick >= compWeight[j]; j += 1)
+            pick -= compWeight[j];
+        _benchComp[i] = comp[j];
+        for (j = 0, total = 0; j < sizeof(destWeight) / sizeof(destWeight[0]); j += 1)
+            total += destWeight[j];
+        for (j = 0, pick = _BenchRandom() % total; pick >= destWeight[j]; j += 1)
+            pick -= destWeight[j];
+        _benchDest[i] = dest[j];
+        for (j = 0, total = 0; j < sizeof(jumpWeight) / sizeof(jumpWeight[0]); j += 1)
+            total += jumpWeight[j];
+        for (j = 0, pick = _BenchRandom() % total; pick >= jumpWeight[j]; j += 1)
+            pick -= jumpWeight[j];
+        _benchJump[i] = jump[j];
+
+        // Mostly small constants and low RAM, some labels across the ROM
+        pick = _BenchRandom() % 10;
+        _benchValues[i] = (int)((pick < 6) ? _BenchRandom() % 256 : (pick < 8) ? 16 + _BenchRandom() % 512 : _BenchRandom() % 32768);
+    }
+
+    for (i = 0; i < _BENCH_SYMBOLS; i += 1)
+    {
+        if (i % 4 == 0)
+            snprintf(_benchSymbols[i], _BENCH_SYMBOL_LENGTH, "LOOP.%u", i);
+        else
+            snprintf(_benchSymbols[i], _BENCH_SYMBOL_LENGTH, "Main.v%u", i);
+        _benchKeys[i] = (int)(_BenchRandom() & 0x7FFFFFFF);
+    }
+}
+
+/* One pass over the corpus. Returns the lines read, or with a function, the calls made to it.
+   Past the first commandType() each applicable line calls the function, commandType()
+   included, _BENCH_PARSER_REPEAT times so that it outweighs the noise of the pass. */
+static unsigned int _BenchParserPass(int function, double *elapsed)
+{
+    const char *p;
+    unsigned int lines, calls;
+    double start;
+    int r, k;
+
+    if (ParserInit(_benchCorpus) != 0)
+    {
+        fprintf(stderr, "[ERROR] Cannot open the corpus '%s', run 'make bench/corpus.asm' first.\n", _benchCorpus);
+        exit(1);
+    }
+    lines = 0;
+    calls = 0;
+    start = _BenchNow();
+    while (hasMoreCommands())
+    {
+        if ((r = advance()) == PARSER_ERROR_EOF_REACHED)
+            break;
+        lines += 1;
+        if (r != 0 || function == _BENCH_PARSER_NONE)
+            continue;
+        r = commandType();
+        _benchSink += (unsigned int)r;
+        if (function == _BENCH_PARSER_BASE)
+            continue;
+        if (function == _BENCH_PARSER_COMMAND_TYPE)
+        {
+            calls += _BENCH_PARSER_REPEAT;
+            for (k = 0; k < _BENCH_PARSER_REPEAT; k += 1)
+                _benchSink += (unsigned int)commandType();
+            continue;
+        }
+        if ((function == _BENCH_PARSER_SYMBOL) != (r != C_COMMAND))
+            continue;
+        calls += _BENCH_PARSER_REPEAT;
+        for (k = 0; k < _BENCH_PARSER_REPEAT; k += 1)
+        {
+            if (function == _BENCH_PARSER_SYMBOL)
+                p = symbol();
+            else if (function == _BENCH_PARSER_DEST)
+                p = dest();
+            else if (function == _BENCH_PARSER_COMP)
+                p = comp();
+            else
+                p = jump();
+            _benchSink += p ? (unsigned int)*p : 0;
+        }
+    }
+    *elapsed = _BenchNow() - start;
+    ParserExit();
+    return (function == _BENCH_PARSER_NONE) ? lines : calls;
+}
+
+/* Time of a parser function alone: the pass with it minus the base pass. A pass that
+   noise made faster than the base one counts as free rather than negative. */
+static double _BenchParserDelta(int function)
+{
+    double with, without;
+    unsigned int calls;
+
+    calls = _BenchParserPass(function, &with);
+    _BenchParserPass(_BENCH_PARSER_BASE, &without);
+    return (with > without) ? (with - without) / calls : 0.0;
+}
+
+static double _BenchAdvance(void)
+{
+    double elapsed;
+    unsigned int lines;
+
+    lines = _BenchParserPass(_BENCH_PARSER_NONE, &elapsed);
+    return elapsed / lines;
+}
+
+static double _BenchCommandType(void)
+{
+    return _BenchParserDelta(_BENCH_PARSER_COMMAND_TYPE);
+}
+
+static double _BenchSymbol(void)
+{
+    return _BenchParserDelta(_BENCH_PARSER_SYMBOL);
+}
+
+static double _BenchDest(void)
+{
+    return _BenchParserDelta(_BENCH_PARSER_DEST);
+}
+
+static double _BenchComp(void)
+{
+    return _BenchParserDelta(_BENCH_PARSER_COMP);
+}
+
+static double _BenchJump(void)
+{
+    return _BenchParserDelta(_BENCH_PARSER_JUMP);
+}
+
+static double _BenchCodeComp(void)
+{
+    double start;
+    unsigned int i;
+
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+        _benchSink += (unsigned int)*Code_comp(_benchComp[i % (sizeof(_benchComp) / sizeof(_benchComp[0]))]);
+    return (_BenchNow() - start) / _BENCH_CALLS;
+}
+
+static double _BenchCodeDest(void)
+{
+    double start;
+    unsigned int i;
+
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+        _benchSink += (unsigned int)*Code_dest(_benchDest[i % (sizeof(_benchDest) / sizeof(_benchDest[0]))]);
+    return (_BenchNow() - start) / _BENCH_CALLS;
+}
+
+static double _BenchCodeJump(void)
+{
+    double start;
+    unsigned int i;
+
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+        _benchSink += (unsigned int)*Code_jump(_benchJump[i % (sizeof(_benchJump) / sizeof(_benchJump[0]))]);
+    return (_BenchNow() - start) / _BENCH_CALLS;
+}
+
+static double _BenchInt2BitString(void)
+{
+    char buffer[16];
+    double start;
+    unsigned int i;
+
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+    {
+        Code_int2bitString(buffer, _benchValues[i % (sizeof(_benchValues) / sizeof(_benchValues[0]))]);
+        _benchSink += (unsigned int)buffer[14];
+    }
+    return (_BenchNow() - start) / _BENCH_CALLS;
+}
+
+/* Per word, formatted in batches of _BENCH_CALLS / 1000. */
+static double _BenchFormatWords(void)
+{
+    static unsigned short words[_BENCH_CALLS / 1000];
+    static char text[_BENCH_CALLS / 1000 * CODE_WORD_TEXT_LENGTH];
+    double start;
+    unsigned int i;
+
+    for (i = 0; i < _BENCH_CALLS / 1000; i += 1)
+        words[i] = (unsigned short)_benchValues[i];
+    start = _BenchNow();
+    for (i = 0; i < 1000; i += 1)
+    {
+        Code_formatWords(text, words, _BENCH_CALLS / 1000);
+        _benchSink += (unsigned int)text[i];
+    }
+    return (_BenchNow() - start) / _BENCH_CALLS;
+}
+
+static double _BenchAddEntry(void)
+{
+    double start, elapsed;
+    unsigned int i;
+
+    SymbolTableInit();
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_SYMBOLS; i += 1)
+        _benchSink += (unsigned int)addEntry(_benchSymbols[i], (int)i, (i % 4 == 0) ? SYMBOL_KIND_LABEL : SYMBOL_KIND_VARIABLE);
+    elapsed = _BenchNow() - start;
+    SymbolTableExit();
+    return elapsed / _BENCH_SYMBOLS;
+}
+
+static double _BenchGetAddress(void)
+{
+    double start, elapsed;
+    unsigned int i;
+
+    SymbolTableInit();
+    for (i = 0; i < _BENCH_SYMBOLS; i += 1)
+        addEntry(_benchSymbols[i], (int)i, SYMBOL_KIND_VARIABLE);
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+        _benchSink += (unsigned int)GetAddress(_benchSymbols[(i * 2654435761u) % _BENCH_SYMBOLS]);
+    elapsed = _BenchNow() - start;
+    SymbolTableExit();
+    return elapsed / _BENCH_CALLS;
+}
+
+static int _Bench_cmp_int(void *a, void *b)
+{
+    int c = *(int *)a, d = *(int *)b;
+
+    return (c > d) - (c < d);
+}
+
+static double _BenchAvlInsert(void)
+{
+    AVL_TREE *tree;
+    double start, elapsed;
+    unsigned int i;
+
+    tree = AVL_Create(_Bench_cmp_int, NULL);
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_SYMBOLS; i += 1)
+        _benchSink += (unsigned int)AVL_Insert(tree, _benchKeys + i);
+    elapsed = _BenchNow() - start;
+    AVL_Destroy(tree);
+    return elapsed / _BENCH_SYMBOLS;
+}
+
+static double _BenchAvlRetrieve(void)
+{
+    AVL_TREE *tree;
+    double start, elapsed;
+    unsigned int i;
+
+    tree = AVL_Create(_Bench_cmp_int, NULL);
+    for (i = 0; i < _BENCH_SYMBOLS; i += 1)
+        AVL_Insert(tree, _benchKeys + i);
+    start = _BenchNow();
+    for (i = 0; i < _BENCH_CALLS; i += 1)
+        _benchSink += (AVL_Retrieve(tree, _benchKeys + (i * 2654435761u) % _BENCH_SYMBOLS) != NULL);
+    elapsed = _BenchNow() - start;
+    AVL_Destroy(tree);
+    return elapsed / _BENCH_CALLS;
+}
+
+// ================================
+
+static const Bench_t _benches[] = {
+    {"advance", _BenchAdvance},
+    {"commandType", _BenchCommandType},
+    {"symbol", _BenchSymbol},
+    {"dest", _BenchDest},
+    {"comp", _BenchComp},
+    {"jump", _BenchJump},
+    {"Code_comp", _BenchCodeComp},
+    {"Code_dest", _BenchCodeDest},
+    {"Code_jump", _BenchCodeJump},
+    {"Code_int2bitString", _BenchInt2BitString},
+    {"Code_formatWords", _BenchFormatWords},
+    {"addEntry", _BenchAddEntry},
+    {"GetAddress", _BenchGetAddress},
+    {"AVL_Insert", _BenchAvlInsert},
+    {"AVL_Retrieve", _BenchAvlRetrieve},
+};
+
+int main(int argc, char **argv)
+{
+    double samples[_BENCH_MAX_REPETITIONS];
+    double mean, deviation, fastest;
+    unsigned int i;
+    int j, repetitions;
+
+    if (argc > 1)
+        _benchCorpus = argv[1];
+    repetitions = (argc > 2) ? atoi(argv[2]) : _BENCH_DEFAULT_REPETITIONS;
+    if (repetitions < 2 || repetitions > _BENCH_MAX_REPETITIONS)
+        repetitions = _BENCH_DEFAULT_REPETITIONS;
+
+    _BenchPrepare();
+    printf("%-20s %12s %12s %12s\n", "function", "ns/op", "stddev", "min");
+    for (i = 0; i < sizeof(_benches) / sizeof(_benches[0]); i += 1)
+    {
+        _benches[i].run(); // Warm up caches and the lazy setup of each module
+        mean = 0;
+        fastest = 0;
+        for (j = 0; j < repetitions; j += 1)
+        {
+            samples[j] = _benches[i].run();
+            mean += samples[j];
+            if (j == 0 || samples[j] < fastest)
+                fastest = samples[j];
+        }
+        mean /= repetitions;
+        for (j = 0, deviation = 0; j < repetitions; j += 1)
+            deviation += (samples[j] - mean) * (samples[j] - mean);
+        deviation = sqrt(deviation / (repetitions - 1));
+        printf("%-20s %12.2f %12.2f %12.2f\n", _benches[i].name, mean, deviation, fastest);
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+    Writes a reproducible Hack program for training and benchmarking, in the shape
+    of VM translator output: comment headers, stack pushes and pops, arithmetic,
+    labels and jumps, variables, and about one blank or comment line in three.
+
+    Usage: corpus [instructions] > corpus.asm
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define _CORPUS_DEFAULT_INSTRUCTIONS 24000
+#define _CORPUS_MAX_INSTRUCTIONS 30000 /* leaves room below the 32K ROM */
+#define _CORPUS_VARIABLES 200
+
+static const char *_corpusComp[] = {"D+M", "M-D", "D&M", "D|M", "-M", "!M", "M+1", "M-1", "D+1", "D-1", "A", "D"};
+static const char *_corpusJump[] = {"JGT", "JEQ", "JGE", "JLT", "JNE", "JLE", "JMP"};
+static const char *_corpusBuiltin[] = {"SP", "LCL", "ARG", "THIS", "THAT", "R13", "R14", "R15"};
+
+static unsigned int _corpusState = 2463534242u;
+static unsigned int _corpusCount = 0;
+static unsigned int _corpusLabels = 0;
+
+#define _CORPUS_PICK(table) (table[_CorpusRandom() % (sizeof(table) / sizeof(table[0]))])
+#define _CORPUS_EMIT(...) (printf(__VA_ARGS__), putchar('\n'), _corpusCount += 1)
+
+static unsigned int _CorpusRandom(void)
+{
+    _corpusState ^= _corpusState << 13;
+    _corpusState ^= _corpusState >> 17;
+    _corpusState ^= _corpusState << 5;
+    return _corpusState;
+}
+
+static void _CorpusPush(void)
+{
+    printf("// push constant\n");
+    _CORPUS_EMIT("@%u", _CorpusRandom() % 32768);
+    _CORPUS_EMIT("D=A");
+    _CORPUS_EMIT("@SP");
+    _CORPUS_EMIT("A=M");
+    _CORPUS_EMIT("M=D");
+    _CORPUS_EMIT("@SP");
+    _CORPUS_EMIT("M=M+1");
+}
+
+static void _CorpusBinary(void)
+{
+    printf("// arithmetic\n");
+    _CORPUS_EMIT("@SP");
+    _CORPUS_EMIT("AM=M-1");
+    _CORPUS_EMIT("D=M");
+    _CORPUS_EMIT("A=A-1");
+    _CORPUS_EMIT("M=%s", _CORPUS_PICK(_corpusComp));
+}
+
+static void _CorpusVariable(void)
+{
+    _CORPUS_EMIT("@%s", _CORPUS_PICK(_corpusBuiltin));
+    _CORPUS_EMIT("D=M");
+    _CORPUS_EMIT("@var%u", _CorpusRandom() % _CORPUS_VARIABLES);
+    _CORPUS_EMIT("M=D");
+}
+
+static void _CorpusBranch(void)
+{
+    unsigned int label = _corpusLabels++;
+
+    printf("\n    // branch %u\n", label);
+    _CORPUS_EMIT("@CORPUS_L%u", label);
+    _CORPUS_EMIT("D;%s", _CORPUS_PICK(_corpusJump));
+    _CORPUS_EMIT("D=D-1");
+    _CORPUS_EMIT("(CORPUS_L%u)", label);
+    _corpusCount -= 1; // Labels take no ROM
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int target;
+
+    target = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : _CORPUS_DEFAULT_INSTRUCTIONS;
+    if (target == 0 || target > _CORPUS_MAX_INSTRUCTIONS)
+        target = _CORPUS_DEFAULT_INSTRUCTIONS;
+
+    printf("// Generated benchmark corpus, %u instructions\n", target);
+    while (_corpusCount + 8 <= target)
+    {
+        switch (_CorpusRandom() % 4)
+        {
+        case 0:
+            _CorpusPush();
+            break;
+        case 1:
+            _CorpusBinary();
+            break;
+        case 2:
+            _CorpusVariable();
+            break;
+        default:
+            _CorpusBranch();
+            break;
+        }
+    }
+    printf("(CORPUS_END)\n@CORPUS_END\n0;JMP\n");
+    return 0;
+}
@@ -41,7 +41,7 @@ static MnemonicToBitString_t _compTable[] = {
     {"D-A", "0010011"},
     {"A-D", "0000111"},
     {"D&A", "0000000"},
-    {"D|A", "010101"},
+    {"D|A", "0010101"},
     {"M", "1110000"},
     {"!M", "1110001"},
     {"-M", "1110011"},
@@ -79,6 +79,13 @@ static Code_comp_t _comp_ptr = Code_comp_setup;
 
 static void _Code_StringMultipleConcat(char *dst, const void **src, const size_t *srcLength, size_t count);
 
+/* The 8 ASCII digits of every byte, most significant bit first, built by the preprocessor. */
+#define _CODE_BITS(n) {'0' + (((n) >> 7) & 1), '0' + (((n) >> 6) & 1), '0' + (((n) >> 5) & 1), '0' + (((n) >> 4) & 1), '0' + (((n) >> 3) & 1), '0' + (((n) >> 2) & 1), '0' + (((n) >> 1) & 1), '0' + ((n) & 1)}
+#define _CODE_BITS4(n) _CODE_BITS(n), _CODE_BITS((n) + 1), _CODE_BITS((n) + 2), _CODE_BITS((n) + 3)
+#define _CODE_BITS16(n) _CODE_BITS4(n), _CODE_BITS4((n) + 4), _CODE_BITS4((n) + 8), _CODE_BITS4((n) + 12)
+#define _CODE_BITS64(n) _CODE_BITS16(n), _CODE_BITS16((n) + 16), _CODE_BITS16((n) + 32), _CODE_BITS16((n) + 48)
+static const char _codeByteBits[256][8] = {_CODE_BITS64(0), _CODE_BITS64(64), _CODE_BITS64(128), _CODE_BITS64(192)};
+
 const char *Code_dest(const char *_dest)
 {
     return _dest_ptr(_dest);
@@ -94,22 +101,49 @@ const char *Code_jump(const char *_jump)
     return _jump_ptr(_jump);
 }
 
-void Code_int2bitString(char *buffer16, int value)
+int Code_int2bitString(char *buffer16, int value)
 {
-    int i = 0;
-    unsigned int v = *(unsigned int *)(&value);
+    unsigned int v = (unsigned int)value;
 
-    memset(buffer16, '0', 15);
+    memcpy(buffer16, _codeByteBits[(v >> 8) & 0x7F] + 1, 7);
+    memcpy(buffer16 + 7, _codeByteBits[v & 0xFF], 8);
     buffer16[15] = '\0';
-    while (v > 0)
+    return (value < 0 || value > CODE_ADDRESS_MAX) ? CODE_ERROR_OUT_OF_RANGE : 0;
+}
+
+unsigned int Code_farPrefix(unsigned int value)
+{
+    return CODE_FAR_PREFIX | ((value >> CODE_ADDRESS_BITS) & ((1u << (CODE_FAR_ADDRESS_BITS - CODE_ADDRESS_BITS)) - 1));
+}
+
+void Code_word2bitString(char *buffer17, unsigned int word)
+{
+    memcpy(buffer17, _codeByteBits[(word >> 8) & 0xFF], 8);
+    memcpy(buffer17 + 8, _codeByteBits[word & 0xFF], 8);
+    buffer17[16] = '\0';
+}
+
+/* Two table copies and a newline per word, no terminator. */
+size_t Code_formatWords(char *buffer, const unsigned short *words, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i += 1, buffer += CODE_WORD_TEXT_LENGTH)
     {
-        if (v % 2)
-            buffer16[14 - i] = '1';
-        v >>= 1;
-        i += 1;
-        if (i > 14)
-            break;
+        memcpy(buffer, _codeByteBits[words[i] >> 8], 8);
+        memcpy(buffer + 8, _codeByteBits[words[i] & 0xFF], 8);
+        buffer[16] = '\n';
     }
+    return count * CODE_WORD_TEXT_LENGTH;
+}
+
+unsigned int Code_bitString2int(const char *bitString)
+{
+    unsigned int value = 0;
+
+    for (; *bitString; bitString += 1)
+        value = (value << 1) | (*bitString == '1');
+    return value;
 }
 
 // ================================
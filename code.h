@@ -1,10 +1,30 @@
 #ifndef _CODE_H_LOADED
 #define _CODE_H_LOADED
 
+#include <stddef.h>
+
 const char *Code_dest(const char *_dest);
 const char *Code_comp(const char *_comp);
 const char *Code_jump(const char *_jump);
 
-void Code_int2bitString(char *buffer16, int value);
+/* Stock A-instructions carry 15-bit values. The extended variant loads wider
+   (far) values with two words: a prefix 10hhhhhhhhhhhhhh latches the high 14 bits
+   for the A-instruction 0lllllllllllllll that follows it. */
+#define CODE_ADDRESS_BITS 15
+#define CODE_ADDRESS_MAX ((1 << CODE_ADDRESS_BITS) - 1)
+#define CODE_FAR_ADDRESS_BITS 29
+#define CODE_FAR_PREFIX 0x8000
+
+int Code_int2bitString(char *buffer16, int value);
+unsigned int Code_farPrefix(unsigned int value);
+void Code_word2bitString(char *buffer17, unsigned int word);
+unsigned int Code_bitString2int(const char *bitString);
+
+/* Formats 'count' words as the .hack lines "0101...\n" into 'buffer', which must hold
+   count * CODE_WORD_TEXT_LENGTH bytes. Returns the number of bytes written. */
+#define CODE_WORD_TEXT_LENGTH 17
+size_t Code_formatWords(char *buffer, const unsigned short *words, size_t count);
+
+#define CODE_ERROR_OUT_OF_RANGE 1
 
 #endif
@@ -0,0 +1,451 @@
+#include "cpu.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Decoded operations, the ALU ones in the order of the Hack specification */
+#define _CPU_OP_GENERIC 0 /* ALU bits outside the specification */
+#define _CPU_OP_ZERO 1
+#define _CPU_OP_ONE 2
+#define _CPU_OP_MINUS_ONE 3
+#define _CPU_OP_X 4
+#define _CPU_OP_Y 5
+#define _CPU_OP_NOT_X 6
+#define _CPU_OP_NOT_Y 7
+#define _CPU_OP_NEG_X 8
+#define _CPU_OP_NEG_Y 9
+#define _CPU_OP_X_PLUS_1 10
+#define _CPU_OP_Y_PLUS_1 11
+#define _CPU_OP_X_MINUS_1 12
+#define _CPU_OP_Y_MINUS_1 13
+#define _CPU_OP_X_PLUS_Y 14
+#define _CPU_OP_X_MINUS_Y 15
+#define _CPU_OP_Y_MINUS_X 16
+#define _CPU_OP_X_AND_Y 17
+#define _CPU_OP_X_OR_Y 18
+#define _CPU_OP_LOAD_A 19
+#define _CPU_OP_PREFIX 20
+#define _CPU_OP_END 21 /* Sentinel after the last word */
+
+#define _CPU_DEST_M 1
+#define _CPU_DEST_D 2
+#define _CPU_DEST_A 4
+
+#define _CPU_JUMP_GT 1
+#define _CPU_JUMP_EQ 2
+#define _CPU_JUMP_LT 4
+
+#define _CPU_READS_M 1
+#define _CPU_HALTS 2
+
+typedef struct
+{
+    unsigned char op;
+    unsigned char dest;
+    unsigned char jump;
+    unsigned char flags;
+    unsigned int operand; // A value, far prefix high bits or the ALU bits
+} CpuInstruction_t;
+
+// zx nx zy ny f no, x is D and y is A or M
+static const unsigned char _cpuAluOps[64] = {
+    [0x2A] = _CPU_OP_ZERO,
+    [0x3F] = _CPU_OP_ONE,
+    [0x3A] = _CPU_OP_MINUS_ONE,
+    [0x0C] = _CPU_OP_X,
+    [0x30] = _CPU_OP_Y,
+    [0x0D] = _CPU_OP_NOT_X,
+    [0x31] = _CPU_OP_NOT_Y,
+    [0x0F] = _CPU_OP_NEG_X,
+    [0x33] = _CPU_OP_NEG_Y,
+    [0x1F] = _CPU_OP_X_PLUS_1,
+    [0x37] = _CPU_OP_Y_PLUS_1,
+    [0x0E] = _CPU_OP_X_MINUS_1,
+    [0x32] = _CPU_OP_Y_MINUS_1,
+    [0x02] = _CPU_OP_X_PLUS_Y,
+    [0x13] = _CPU_OP_X_MINUS_Y,
+    [0x07] = _CPU_OP_Y_MINUS_X,
+    [0x00] = _CPU_OP_X_AND_Y,
+    [0x15] = _CPU_OP_X_OR_Y};
+
+static const char *_cpuStopNames[] = {"halted", "end-of-rom", "bad-address", "cycle-limit"};
+
+static unsigned short *_cpuRom = NULL;
+static size_t _cpuRomCount = 0;
+static size_t _cpuRomCapacity = 0;
+static CpuInstruction_t *_cpuDecoded = NULL;
+static size_t _cpuDecodedCapacity = 0;
+static short _cpuRam[CPU_RAM_SIZE];
+static size_t _cpuAccounted = 0;
+
+static int _Cpu_decode(void);
+static int _Cpu_usesY(int op);
+static void _Cpu_account(void);
+
+int CpuLoad(const unsigned short *words, size_t count)
+{
+    unsigned short *rom;
+    size_t capacity;
+
+    if (_cpuRomCount + count > _cpuRomCapacity)
+    {
+        capacity = _cpuRomCapacity ? _cpuRomCapacity : 4096;
+        while (_cpuRomCount + count > capacity)
+            capacity *= 2;
+        if ((rom = (unsigned short *)realloc(_cpuRom, capacity * sizeof(*rom))) == NULL)
+            return CPU_ERROR_NO_MEMORY;
+        _cpuRom = rom;
+        _cpuRomCapacity = capacity;
+        _Cpu_account();
+    }
+    memcpy(_cpuRom + _cpuRomCount, words, count * sizeof(*words));
+    _cpuRomCount += count;
+    return 0;
+}
+
+size_t CpuRomSize(void)
+{
+    return _cpuRomCount;
+}
+
+const unsigned short *CpuRom(void)
+{
+    return _cpuRom;
+}
+
+#if defined(__GNUC__)
+// Threaded: every operation ends with its own indirect jump to the next one
+#define _CPU_OP(name) _cpuOp_##name:
+#define _CPU_NEXT()                      \
+    do                                   \
+    {                                    \
+        if (remaining == 0)              \
+            goto cycleLimit;             \
+        remaining -= 1;                  \
+        insn = _cpuDecoded + pc;         \
+        goto *operations[insn->op];      \
+    } while (0)
+#else
+#define _CPU_OP(name) case _CPU_OP_##name:
+#define _CPU_NEXT() goto next
+#endif
+
+#define _CPU_FETCH_Y()                     \
+    do                                     \
+    {                                      \
+        if (!(insn->flags & _CPU_READS_M)) \
+            y = (short)a;                  \
+        else if (a < CPU_RAM_SIZE)         \
+            y = _cpuRam[a];                \
+        else                               \
+            goto badAddress;               \
+    } while (0)
+
+int CpuRun(unsigned long maxCycles, CpuResult_t *result)
+{
+#if defined(__GNUC__)
+    static const void *operations[] = {
+        &&_cpuOp_GENERIC, &&_cpuOp_ZERO, &&_cpuOp_ONE, &&_cpuOp_MINUS_ONE, &&_cpuOp_X, &&_cpuOp_Y,
+        &&_cpuOp_NOT_X, &&_cpuOp_NOT_Y, &&_cpuOp_NEG_X, &&_cpuOp_NEG_Y, &&_cpuOp_X_PLUS_1, &&_cpuOp_Y_PLUS_1,
+        &&_cpuOp_X_MINUS_1, &&_cpuOp_Y_MINUS_1, &&_cpuOp_X_PLUS_Y, &&_cpuOp_X_MINUS_Y, &&_cpuOp_Y_MINUS_X,
+        &&_cpuOp_X_AND_Y, &&_cpuOp_X_OR_Y, &&_cpuOp_LOAD_A, &&_cpuOp_PREFIX, &&_cpuOp_END};
+#endif
+    const CpuInstruction_t *insn;
+    unsigned long remaining;
+    unsigned int pc, a, high, target;
+    int d, x, y, out, stop;
+
+    if (_Cpu_decode() != 0)
+        return CPU_ERROR_NO_MEMORY;
+    memset(_cpuRam, 0, sizeof(_cpuRam));
+    pc = a = high = target = 0;
+    d = x = y = out = 0;
+    remaining = maxCycles;
+
+#if defined(__GNUC__)
+    _CPU_NEXT();
+    {
+#else
+next:
+    if (remaining == 0)
+        goto cycleLimit;
+    remaining -= 1;
+    insn = _cpuDecoded + pc;
+    switch (insn->op)
+    {
+#endif
+        _CPU_OP(LOAD_A)
+        a = (high << 15) | insn->operand;
+        high = 0;
+        pc += 1;
+        _CPU_NEXT();
+        _CPU_OP(PREFIX)
+        high = insn->operand;
+        pc += 1;
+        _CPU_NEXT();
+        _CPU_OP(END)
+        remaining += 1; // Not an instruction
+        stop = CPU_STOP_END_OF_ROM;
+        goto done;
+
+        _CPU_OP(ZERO)
+        out = 0;
+        goto store;
+        _CPU_OP(ONE)
+        out = 1;
+        goto store;
+        _CPU_OP(MINUS_ONE)
+        out = -1;
+        goto store;
+        _CPU_OP(X)
+        out = d;
+        goto store;
+        _CPU_OP(Y)
+        _CPU_FETCH_Y();
+        out = y;
+        goto store;
+        _CPU_OP(NOT_X)
+        out = ~d;
+        goto store;
+        _CPU_OP(NOT_Y)
+        _CPU_FETCH_Y();
+        out = ~y;
+        goto store;
+        _CPU_OP(NEG_X)
+        out = -d;
+        goto store;
+        _CPU_OP(NEG_Y)
+        _CPU_FETCH_Y();
+        out = -y;
+        goto store;
+        _CPU_OP(X_PLUS_1)
+        out = d + 1;
+        goto store;
+        _CPU_OP(Y_PLUS_1)
+        _CPU_FETCH_Y();
+        out = y + 1;
+        goto store;
+        _CPU_OP(X_MINUS_1)
+        out = d - 1;
+        goto store;
+        _CPU_OP(Y_MINUS_1)
+        _CPU_FETCH_Y();
+        out = y - 1;
+        goto store;
+        _CPU_OP(X_PLUS_Y)
+        _CPU_FETCH_Y();
+        out = d + y;
+        goto store;
+        _CPU_OP(X_MINUS_Y)
+        _CPU_FETCH_Y();
+        out = d - y;
+        goto store;
+        _CPU_OP(Y_MINUS_X)
+        _CPU_FETCH_Y();
+        out = y - d;
+        goto store;
+        _CPU_OP(X_AND_Y)
+        _CPU_FETCH_Y();
+        out = d & y;
+        goto store;
+        _CPU_OP(X_OR_Y)
+        _CPU_FETCH_Y();
+        out = d | y;
+        goto store;
+        _CPU_OP(GENERIC)
+        _CPU_FETCH_Y();
+        x = (insn->operand & 0x20) ? 0 : d;
+        x = (insn->operand & 0x10) ? ~x : x;
+        y = (insn->operand & 0x08) ? 0 : y;
+        y = (insn->operand & 0x04) ? ~y : y;
+        out = (insn->operand & 0x02) ? x + y : x & y;
+        out = (insn->operand & 0x01) ? ~out : out;
+        goto store;
+    }
+
+// M is written and the jump taken with A as it was before this instruction
+store:
+    out = (short)out;
+    target = a;
+    if (insn->dest & _CPU_DEST_M)
+    {
+        if (a >= CPU_RAM_SIZE)
+            goto badAddress;
+        _cpuRam[a] = (short)out;
+    }
+    if (insn->dest & _CPU_DEST_A)
+        a = (unsigned short)out;
+    if (insn->dest & _CPU_DEST_D)
+        d = out;
+    if (insn->jump & ((out < 0) ? _CPU_JUMP_LT : (out == 0) ? _CPU_JUMP_EQ : _CPU_JUMP_GT))
+    {
+        if ((insn->flags & _CPU_HALTS) && (int)target == CpuHaltAddress(_cpuRom, pc))
+        {
+            pc = target;
+            stop = CPU_STOP_HALTED;
+            goto done;
+        }
+        pc = target;
+        if (target >= _cpuRomCount)
+        {
+            stop = CPU_STOP_END_OF_ROM;
+            goto done;
+        }
+    }
+    else
+        pc += 1;
+    _CPU_NEXT();
+
+badAddress:
+    stop = CPU_STOP_BAD_ADDRESS;
+    goto done;
+cycleLimit:
+    stop = CPU_STOP_CYCLE_LIMIT;
+done:
+    result->cycles = maxCycles - remaining;
+    result->stop = stop;
+    result->pc = pc;
+    result->a = a;
+    result->d = d;
+    return 0;
+}
+
+/* The A value is resolved through the far prefix, so "@END" stays a halt at any address width. */
+int CpuHaltAddress(const unsigned short *words, size_t i)
+{
+    unsigned int target;
+    size_t load;
+
+    if ((words[i] & 0xC03F) != 0xC007 || i == 0 || (words[i - 1] & 0x8000))
+        return -1;
+    target = words[i - 1];
+    load = i - 1;
+    if (load > 0 && (words[load - 1] & 0xC000) == 0x8000)
+    {
+        load -= 1;
+        target |= (unsigned int)(words[load] & 0x3FFF) << 15;
+    }
+    return (target == load) ? (int)load : -1;
+}
+
+int CpuRam(unsigned int address)
+{
+    return (address < CPU_RAM_SIZE) ? _cpuRam[address] : 0;
+}
+
+const char *CpuStopName(int stop)
+{
+    if (stop < 0 || stop >= (int)(sizeof(_cpuStopNames) / sizeof(_cpuStopNames[0])))
+        return "unknown";
+    return _cpuStopNames[stop];
+}
+
+int CpuReport(FILE *f, const CpuResult_t *result, unsigned int first, unsigned int last, int nonZeroOnly)
+{
+    unsigned int i;
+
+    if (fprintf(f, "cycles %lu\nstop %s\nPC %u\nA %u\nD %d\n", result->cycles, CpuStopName(result->stop), result->pc, result->a, result->d) < 0)
+        return CPU_ERROR_CANNOT_WRITE;
+    for (i = first; i <= last && i < CPU_RAM_SIZE; i += 1)
+        if ((!nonZeroOnly || _cpuRam[i]) && fprintf(f, "RAM %u %d\n", i, _cpuRam[i]) < 0)
+            return CPU_ERROR_CANNOT_WRITE;
+    return 0;
+}
+
+void CpuClear(void)
+{
+    _cpuRomCount = 0;
+}
+
+void CpuExit(void)
+{
+    free(_cpuRom);
+    free(_cpuDecoded);
+    _cpuRom = NULL;
+    _cpuDecoded = NULL;
+    _cpuRomCount = _cpuRomCapacity = _cpuDecodedCapacity = 0;
+    _Cpu_account();
+}
+
+// ================================
+
+/* One entry per word plus the END sentinel, so that only jumps check the PC. */
+static int _Cpu_decode(void)
+{
+    CpuInstruction_t *decoded, *insn;
+    unsigned int word, c;
+    size_t i;
+
+    if (_cpuRomCount + 1 > _cpuDecodedCapacity)
+    {
+        if ((decoded = (CpuInstruction_t *)realloc(_cpuDecoded, (_cpuRomCount + 1) * sizeof(*decoded))) == NULL)
+            return CPU_ERROR_NO_MEMORY;
+        _cpuDecoded = decoded;
+        _cpuDecodedCapacity = _cpuRomCount + 1;
+        _Cpu_account();
+    }
+
+    for (i = 0; i < _cpuRomCount; i += 1)
+    {
+        insn = _cpuDecoded + i;
+        word = _cpuRom[i];
+        insn->dest = insn->jump = insn->flags = 0;
+        if (!(word & 0x8000))
+        {
+            insn->op = _CPU_OP_LOAD_A;
+            insn->operand = word;
+        }
+        else if (!(word & 0x4000))
+        {
+            insn->op = _CPU_OP_PREFIX;
+            insn->operand = word & 0x3FFF;
+        }
+        else
+        {
+            c = (word >> 6) & 0x3F;
+            insn->op = _cpuAluOps[c];
+            insn->operand = c;
+            insn->dest = (word >> 3) & 7;
+            insn->jump = word & 7;
+            if ((word & 0x1000) && _Cpu_usesY(insn->op))
+                insn->flags |= _CPU_READS_M;
+            if (CpuHaltAddress(_cpuRom, i) >= 0)
+                insn->flags |= _CPU_HALTS;
+        }
+    }
+    _cpuDecoded[_cpuRomCount].op = _CPU_OP_END;
+    return 0;
+}
+
+static int _Cpu_usesY(int op)
+{
+    switch (op)
+    {
+    case _CPU_OP_ZERO:
+    case _CPU_OP_ONE:
+    case _CPU_OP_MINUS_ONE:
+    case _CPU_OP_X:
+    case _CPU_OP_NOT_X:
+    case _CPU_OP_NEG_X:
+    case _CPU_OP_X_PLUS_1:
+    case _CPU_OP_X_MINUS_1:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+static void _Cpu_account(void)
+{
+    size_t bytes;
+
+    bytes = _cpuRomCapacity * sizeof(*_cpuRom) + _cpuDecodedCapacity * sizeof(*_cpuDecoded);
+    if (_cpuRomCapacity)
+        bytes += sizeof(_cpuRam);
+    if (bytes > _cpuAccounted)
+        MemoryAllocated(MEMORY_CPU, bytes - _cpuAccounted);
+    else
+        MemoryReleased(MEMORY_CPU, _cpuAccounted - bytes);
+    _cpuAccounted = bytes;
+}
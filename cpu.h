@@ -0,0 +1,64 @@
+#ifndef _CPU_H_LOADED
+#define _CPU_H_LOADED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+    Hack CPU interpreter behind --run. The second pass loads the words it emits into
+    ROM; CpuRun() then executes them from PC 0 with A, D and the RAM cleared.
+
+    Every word is decoded once before the run. The 6 ALU bits of a C-instruction pick
+    the operation from a 64-entry table (combinations outside the 18 of the Hack
+    specification are computed from the bits), the a bit picks A or M as the y input.
+    The run dispatches on the decoded operation with computed goto where the compiler
+    has it, a switch otherwise.
+
+    A far prefix (code.h) latches the high bits for the A-instruction that follows it.
+
+    A run stops when
+        the program halts, an unconditional jump with no dest onto the "@X" right
+        before it at X, far prefix included (the usual end loop),
+        the PC leaves the ROM,
+        M is used while A is outside the RAM, or
+        the cycle limit is reached.
+*/
+
+#define CPU_RAM_SIZE 32768 /* data, screen and keyboard */
+#define CPU_DEFAULT_CYCLES 100000000UL
+
+#define CPU_STOP_HALTED 0
+#define CPU_STOP_END_OF_ROM 1
+#define CPU_STOP_BAD_ADDRESS 2
+#define CPU_STOP_CYCLE_LIMIT 3
+
+typedef struct
+{
+    unsigned long cycles;
+    int stop;
+    unsigned int pc;
+    unsigned int a;
+    int d;
+} CpuResult_t;
+
+/* Appends to the ROM. */
+int CpuLoad(const unsigned short *words, size_t count);
+size_t CpuRomSize(void);
+/* The words loaded so far, for --emit-c (translate.h). */
+const unsigned short *CpuRom(void);
+int CpuRun(unsigned long maxCycles, CpuResult_t *result);
+/* The address the word at i halts at, -1 if it is not the end loop above. The C
+   simulator of --emit-c stops on the same words. */
+int CpuHaltAddress(const unsigned short *words, size_t i);
+int CpuRam(unsigned int address);
+const char *CpuStopName(int stop);
+/* Registers, then RAM[first] to RAM[last]; only the non-zero words when nonZeroOnly. */
+int CpuReport(FILE *f, const CpuResult_t *result, unsigned int first, unsigned int last, int nonZeroOnly);
+/* Empty the ROM for the next program, keeping its buffers. */
+void CpuClear(void);
+void CpuExit(void);
+
+#define CPU_ERROR_NO_MEMORY 1
+#define CPU_ERROR_CANNOT_WRITE 2
+
+#endif
@@ -0,0 +1,220 @@
+#include "diagnostic.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    unsigned int file; // Index into _diagnosticFiles
+    unsigned int line;
+    unsigned int column;
+    unsigned int sequence;
+    unsigned int subject; // Offset into the pool
+    int code;
+} DiagnosticRecord_t;
+
+typedef struct
+{
+    const char *module;
+    const char *message; // '%s' is the subject
+} DiagnosticMessage_t;
+
+static const DiagnosticMessage_t _diagnosticMessages[] = {
+    {"Assembler", "Unexpected error '%s'"},
+    {"Parser", "Symbol is NULL (%s)"},
+    {"Parser", "Malformed constant '%s'"},
+    {"Parser", "Constant '%s' does not fit into the address width"},
+    {"Parser", "comp is NULL%s"},
+    {"Code", "Failed to turn dest '%s' to bit string"},
+    {"Code", "Failed to turn comp '%s' to bit string"},
+    {"Code", "Failed to turn jump '%s' to bit string"},
+    {"Parser", "Too much character on a single line%s"},
+    {"Preprocessor", "%s"},
+    {"Assembler", "Program does not fit into the %s-word ROM"},
+    {"Assembler", "Address %s does not fit into the address width"},
+    {"Symbol Table", "Failed to add the symbol '%s'"},
+    {"Instruction", "Out of memory storing the instruction%s"},
+    {"Parser", "I/O read error, error code from OS: %s"},
+};
+
+static DiagnosticRecord_t *_diagnosticRecords = NULL;
+static unsigned int _diagnosticCount = 0;
+static unsigned int _diagnosticCapacity = 0;
+static char *_diagnosticPool = NULL;
+static size_t _diagnosticPoolLength = 0;
+static size_t _diagnosticPoolCapacity = 0;
+static unsigned int *_diagnosticFiles = NULL; // Pool offsets of the file names
+static unsigned int _diagnosticFileCount = 0;
+
+static int _Diagnostic_intern(const char *string, unsigned int *offset);
+static int _Diagnostic_file(const char *file, unsigned int *index);
+static int _Diagnostic_cmp_DiagnosticRecord(const void *a, const void *b);
+static int _Diagnostic_writeJsonString(FILE *f, const char *string);
+
+int DiagnosticAdd(const char *file, unsigned int line, unsigned int column, int code, const char *subject)
+{
+    DiagnosticRecord_t *records;
+    unsigned int capacity, fileIndex, subjectOffset;
+
+    if (_Diagnostic_file(file, &fileIndex) || _Diagnostic_intern(subject ? subject : "", &subjectOffset))
+        return DIAGNOSTIC_ERROR_NO_MEMORY;
+    if (_diagnosticCount == _diagnosticCapacity)
+    {
+        capacity = _diagnosticCapacity ? _diagnosticCapacity * 2 : 64;
+        if ((records = (DiagnosticRecord_t *)realloc(_diagnosticRecords, capacity * sizeof(*records))) == NULL)
+            return DIAGNOSTIC_ERROR_NO_MEMORY;
+        _diagnosticRecords = records;
+        _diagnosticCapacity = capacity;
+    }
+
+    if (code <= 0 || code >= (int)(sizeof(_diagnosticMessages) / sizeof(_diagnosticMessages[0])))
+        code = DIAGNOSTIC_INTERNAL;
+    _diagnosticRecords[_diagnosticCount].file = fileIndex;
+    _diagnosticRecords[_diagnosticCount].line = line;
+    _diagnosticRecords[_diagnosticCount].column = column;
+    _diagnosticRecords[_diagnosticCount].sequence = _diagnosticCount;
+    _diagnosticRecords[_diagnosticCount].subject = subjectOffset;
+    _diagnosticRecords[_diagnosticCount].code = code;
+    _diagnosticCount += 1;
+    return 0;
+}
+
+unsigned int DiagnosticCount(void)
+{
+    return _diagnosticCount;
+}
+
+int DiagnosticEmit(FILE *f, int format)
+{
+    char message[512];
+    const DiagnosticRecord_t *record;
+    const DiagnosticMessage_t *text;
+    const char *file;
+    unsigned int i;
+    int r;
+
+    if (format != DIAGNOSTIC_FORMAT_TEXT && format != DIAGNOSTIC_FORMAT_JSON)
+        return DIAGNOSTIC_ERROR_UNKNOWN_FORMAT;
+
+    qsort(_diagnosticRecords, _diagnosticCount, sizeof(*_diagnosticRecords), _Diagnostic_cmp_DiagnosticRecord);
+    r = 0;
+    if (format == DIAGNOSTIC_FORMAT_JSON && fputs("[", f) < 0)
+        r = DIAGNOSTIC_ERROR_CANNOT_WRITE;
+    for (i = 0; i < _diagnosticCount && r == 0; i += 1)
+    {
+        record = _diagnosticRecords + i;
+        text = _diagnosticMessages + (record->code == DIAGNOSTIC_INTERNAL ? 0 : record->code);
+        file = _diagnosticPool + _diagnosticFiles[record->file];
+        snprintf(message, sizeof(message), text->message, _diagnosticPool + record->subject);
+        if (format == DIAGNOSTIC_FORMAT_TEXT)
+        {
+            if (fprintf(f, "[ERROR] Module %s failed to parse file '%s' on line %u, column %u:\n\t%s.\n", text->module, file, record->line, record->column, message) < 0)
+                r = DIAGNOSTIC_ERROR_CANNOT_WRITE;
+        }
+        else
+        {
+            if (fprintf(f, "%s\n  {\"file\": ", i ? "," : "") < 0 || _Diagnostic_writeJsonString(f, file) || fprintf(f, ", \"line\": %u, \"column\": %u, \"code\": %d, \"module\": ", record->line, record->column, record->code) < 0 || _Diagnostic_writeJsonString(f, text->module) || fputs(", \"message\": ", f) < 0 || _Diagnostic_writeJsonString(f, message) || fputs("}", f) < 0)
+                r = DIAGNOSTIC_ERROR_CANNOT_WRITE;
+        }
+    }
+    if (format == DIAGNOSTIC_FORMAT_JSON && r == 0 && fputs("\n]\n", f) < 0)
+        r = DIAGNOSTIC_ERROR_CANNOT_WRITE;
+    return r;
+}
+
+void DiagnosticClear(void)
+{
+    free(_diagnosticRecords);
+    free(_diagnosticPool);
+    free(_diagnosticFiles);
+    _diagnosticRecords = NULL;
+    _diagnosticPool = NULL;
+    _diagnosticFiles = NULL;
+    _diagnosticCount = _diagnosticCapacity = _diagnosticFileCount = 0;
+    _diagnosticPoolLength = _diagnosticPoolCapacity = 0;
+}
+
+// ================================
+
+static int _Diagnostic_intern(const char *string, unsigned int *offset)
+{
+    size_t length, capacity;
+    char *pool;
+
+    length = strlen(string) + 1;
+    if (_diagnosticPoolLength + length > _diagnosticPoolCapacity)
+    {
+        capacity = _diagnosticPoolCapacity ? _diagnosticPoolCapacity * 2 : 1024;
+        while (_diagnosticPoolLength + length > capacity)
+            capacity *= 2;
+        if ((pool = (char *)realloc(_diagnosticPool, capacity)) == NULL)
+            return 1;
+        _diagnosticPool = pool;
+        _diagnosticPoolCapacity = capacity;
+    }
+    memcpy(_diagnosticPool + _diagnosticPoolLength, string, length);
+    *offset = (unsigned int)_diagnosticPoolLength;
+    _diagnosticPoolLength += length;
+    return 0;
+}
+
+/* Files are few and reported in runs, the last one is checked first. */
+static int _Diagnostic_file(const char *file, unsigned int *index)
+{
+    unsigned int *files;
+    unsigned int i;
+
+    for (i = _diagnosticFileCount; i > 0; i -= 1)
+        if (strcmp(_diagnosticPool + _diagnosticFiles[i - 1], file) == 0)
+        {
+            *index = i - 1;
+            return 0;
+        }
+
+    if ((files = (unsigned int *)realloc(_diagnosticFiles, (_diagnosticFileCount + 1) * sizeof(*files))) == NULL)
+        return 1;
+    _diagnosticFiles = files;
+    if (_Diagnostic_intern(file, files + _diagnosticFileCount))
+        return 1;
+    *index = _diagnosticFileCount;
+    _diagnosticFileCount += 1;
+    return 0;
+}
+
+static int _Diagnostic_cmp_DiagnosticRecord(const void *a, const void *b)
+{
+    const DiagnosticRecord_t *c = (const DiagnosticRecord_t *)a;
+    const DiagnosticRecord_t *d = (const DiagnosticRecord_t *)b;
+
+    if (c->file != d->file)
+        return (c->file > d->file) ? 1 : -1;
+    if (c->line != d->line)
+        return (c->line > d->line) ? 1 : -1;
+    if (c->column != d->column)
+        return (c->column > d->column) ? 1 : -1;
+    if (c->sequence != d->sequence)
+        return (c->sequence > d->sequence) ? 1 : -1;
+    return 0;
+}
+
+static int _Diagnostic_writeJsonString(FILE *f, const char *string)
+{
+    if (fputc('"', f) == EOF)
+        return 1;
+    for (; *string; string += 1)
+    {
+        if (*string == '"' || *string == '\\')
+        {
+            if (fputc('\\', f) == EOF || fputc(*string, f) == EOF)
+                return 1;
+        }
+        else if ((unsigned char)*string < 0x20)
+        {
+            if (fprintf(f, "\\u%04x", (unsigned int)(unsigned char)*string) < 0)
+                return 1;
+        }
+        else if (fputc(*string, f) == EOF)
+            return 1;
+    }
+    return (fputc('"', f) == EOF) ? 1 : 0;
+}
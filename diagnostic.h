@@ -0,0 +1,42 @@
+#ifndef _DIAGNOSTIC_H_LOADED
+#define _DIAGNOSTIC_H_LOADED
+
+#include <stdio.h>
+
+/*
+    Errors collected while assembling, emitted together once all files are done.
+    Each record is { file, line, column, code, subject }; the file and the subject
+    are kept once in a shared string pool. Emission is sorted by file (in the order
+    the files were first reported), then line, then column.
+*/
+
+#define DIAGNOSTIC_FORMAT_TEXT 1
+#define DIAGNOSTIC_FORMAT_JSON 2
+
+/* Codes, the message of each is in diagnostic.c */
+#define DIAGNOSTIC_EMPTY_SYMBOL 1
+#define DIAGNOSTIC_MALFORMED_CONSTANT 2
+#define DIAGNOSTIC_CONSTANT_OUT_OF_RANGE 3
+#define DIAGNOSTIC_EMPTY_COMP 4
+#define DIAGNOSTIC_UNKNOWN_DEST 5
+#define DIAGNOSTIC_UNKNOWN_COMP 6
+#define DIAGNOSTIC_UNKNOWN_JUMP 7
+#define DIAGNOSTIC_LINE_TOO_LONG 8
+#define DIAGNOSTIC_PREPROCESSOR 9
+#define DIAGNOSTIC_ROM_OVERFLOW 10
+#define DIAGNOSTIC_ADDRESS_OUT_OF_RANGE 11
+#define DIAGNOSTIC_SYMBOL_TABLE 12
+#define DIAGNOSTIC_NO_MEMORY 13
+#define DIAGNOSTIC_READ_ERROR 14
+#define DIAGNOSTIC_INTERNAL 15
+
+int DiagnosticAdd(const char *file, unsigned int line, unsigned int column, int code, const char *subject);
+unsigned int DiagnosticCount(void);
+int DiagnosticEmit(FILE *f, int format);
+void DiagnosticClear(void);
+
+#define DIAGNOSTIC_ERROR_NO_MEMORY 1
+#define DIAGNOSTIC_ERROR_UNKNOWN_FORMAT 2
+#define DIAGNOSTIC_ERROR_CANNOT_WRITE 3
+
+#endif
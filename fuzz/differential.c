@@ -0,0 +1,678 @@
+/*
+    Differential fuzzer for the parser and the encoder.
+
+    Random Hack programs are assembled twice: by the real pipeline (main.c built as
+    AssemblerMain, with stdout sent to a temporary file) and by the small reference
+    encoder below, which is written straight from the Hack specification and shares
+    no code with the assembler. The outputs must match word for word; a program the
+    reference rejects must produce no output at all. Every fourth program also goes
+    through -c and --link, every other one of the rest through --async-io. Half of
+    the linked programs are two objects: the program twice, so that both define the
+    same labels, the first ending with a label the second jumps to. Each copy has to
+    keep its own labels while sharing the variables and the exported label.
+
+    The programs vary what the trimming and splitting code has to cope with:
+    indentation, spaces around '=', ';' and the operator, trailing comments,
+    blank and comment lines, CRLF endings, a last line without a newline, any
+    order of the dest letters, and now and then a line that must be rejected.
+
+    Usage: differential [iterations] [seed]
+           differential --throughput corpus.asm [minimum lines per second]
+
+    The throughput mode assembles the corpus a few times and fails when the best
+    run is slower than the given rate.
+
+    Built with -DFUZZ_LIBFUZZER and clang -fsanitize=fuzzer, LLVMFuzzerTestOneInput
+    takes the generator choices from the fuzzer input instead of the random state.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define _FUZZ_DEFAULT_ITERATIONS 2000
+#define _FUZZ_DEFAULT_MIN_LINES_PER_SECOND 500000.0
+#define _FUZZ_THROUGHPUT_RUNS 5
+#define _FUZZ_MAX_LINES 400
+#define _FUZZ_PROGRAM_SIZE (_FUZZ_MAX_LINES * 96)
+#define _FUZZ_MAX_WORDS (_FUZZ_MAX_LINES + 1)
+#define _FUZZ_MAX_LINKED_WORDS (_FUZZ_MAX_WORDS * 2 + 2)
+#define _FUZZ_LINE_LENGTH 128
+#define _FUZZ_LITERAL_MAX 32767
+#define _FUZZ_FIRST_VARIABLE 16
+#define _FUZZ_LABEL_NAMES 12
+#define _FUZZ_ENTRY_LABEL "Link.entry"
+#define _FUZZ_JUMP 0xEA87 // 0;JMP
+
+int AssemblerMain(int argc, char **argv);
+
+typedef struct
+{
+    const char *mnemonic;
+    unsigned int bits;
+} FuzzMnemonic_t;
+
+typedef struct
+{
+    unsigned int state;
+    const unsigned char *data; // libFuzzer input, NULL for the random state
+    size_t size;
+    size_t position;
+} FuzzSource_t;
+
+typedef struct
+{
+    char name[_FUZZ_LINE_LENGTH];
+    unsigned int address;
+    int label;
+} FuzzSymbol_t;
+
+// From the specification, comp bits are a c1 c2 c3 c4 c5 c6
+static const FuzzMnemonic_t _fuzzComp[] = {
+    {"0", 0x2A}, {"1", 0x3F}, {"-1", 0x3A}, {"D", 0x0C}, {"A", 0x30}, {"!D", 0x0D}, {"!A", 0x31}, {"-D", 0x0F}, {"-A", 0x33}, {"D+1", 0x1F}, {"A+1", 0x37}, {"D-1", 0x0E}, {"A-1", 0x32}, {"D+A", 0x02}, {"D-A", 0x13}, {"A-D", 0x07}, {"D&A", 0x00}, {"D|A", 0x15}, {"M", 0x70}, {"!M", 0x71}, {"-M", 0x73}, {"M+1", 0x77}, {"M-1", 0x72}, {"D+M", 0x42}, {"D-M", 0x53}, {"M-D", 0x47}, {"D&M", 0x40}, {"D|M", 0x55}};
+
+static const FuzzMnemonic_t _fuzzJump[] = {
+    {"JGT", 1}, {"JEQ", 2}, {"JGE", 3}, {"JLT", 4}, {"JNE", 5}, {"JLE", 6}, {"JMP", 7}};
+
+static const FuzzMnemonic_t _fuzzBuiltin[] = {
+    {"SP", 0}, {"LCL", 1}, {"ARG", 2}, {"THIS", 3}, {"THAT", 4}, {"R0", 0}, {"R1", 1}, {"R2", 2}, {"R3", 3}, {"R4", 4}, {"R5", 5}, {"R6", 6}, {"R7", 7}, {"R8", 8}, {"R9", 9}, {"R10", 10}, {"R11", 11}, {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15}, {"SCREEN", 16384}, {"KBD", 24576}};
+
+static const char *_fuzzLabels[_FUZZ_LABEL_NAMES] = {"LOOP", "END", "Main.main", "Sys.init$ret.0", "f.x$if_true", "_start", "a:b", "L0", "L1", "L2", "WHILE_EXP", "Foo.bar$end"};
+static const char *_fuzzVariables[] = {"i", "n", "sum", "Main.0", "Foo.count", "x_1", "tmp$", "p:q"};
+static const char *_fuzzInvalid[] = {"@12a", "@32768", "@99999", "D=D+Q", "X=D", "D;JXX", "=D", "D;", "MDM=1", "AMD=D+A+1"};
+
+static char _fuzzProgram[_FUZZ_PROGRAM_SIZE];
+static char _fuzzInputPath[] = "/tmp/hack-differential-XXXXXX.asm";
+static char _fuzzObjectPath[sizeof(_fuzzInputPath) + 1];
+static char _fuzzSecondPath[] = "/tmp/hack-differential-XXXXXX.asm";
+static char _fuzzSecondObjectPath[sizeof(_fuzzSecondPath) + 1];
+static char _fuzzOutputPath[] = "/tmp/hack-differential-XXXXXX.out";
+
+static unsigned int _Fuzz_next(FuzzSource_t *source, unsigned int bound);
+static size_t _Fuzz_generate(FuzzSource_t *source, char *program, size_t size);
+static void _Fuzz_trim(char *string);
+static int _Fuzz_lookup(const FuzzMnemonic_t *table, size_t count, const char *mnemonic, unsigned int *bits);
+static const FuzzSymbol_t *_Fuzz_symbol(const FuzzSymbol_t *symbols, unsigned int count, const char *name);
+static int _Fuzz_encodeC(char *line, unsigned int *word);
+static int _Fuzz_reference(char *program, unsigned short *words, unsigned char *labels, unsigned int *count);
+static void _Fuzz_link(unsigned short *words, const unsigned char *labels, unsigned int *count);
+static int _Fuzz_write(const char *path, const char *program, size_t length, const char *trailer);
+static int _Fuzz_assemble(const char *program, size_t length, int link, unsigned short *words, unsigned int *count);
+static int _Fuzz_check(const char *program, size_t length, int link, const char *label);
+static int _Fuzz_setup(void);
+static void _Fuzz_cleanup(void);
+static int _Fuzz_throughput(const char *corpus, double minimum);
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    static int ready = 0;
+    FuzzSource_t source;
+    size_t length;
+
+    if (!ready)
+    {
+        if (_Fuzz_setup() != 0)
+            abort();
+        atexit(_Fuzz_cleanup);
+        ready = 1;
+    }
+    source.state = 2463534242u;
+    source.data = data;
+    source.size = size;
+    source.position = 0;
+    length = _Fuzz_generate(&source, _fuzzProgram, sizeof(_fuzzProgram));
+    if (_Fuzz_check(_fuzzProgram, length, (size > 0 && data[0] % 4 == 0) ? 1 + data[0] / 4 % 2 : 0, "libFuzzer input") != 0)
+        abort();
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv)
+{
+    FuzzSource_t source;
+    unsigned long iterations, i;
+    size_t length;
+    int r;
+
+    if (argc >= 3 && strcmp(argv[1], "--throughput") == 0)
+        return _Fuzz_throughput(argv[2], (argc >= 4) ? atof(argv[3]) : _FUZZ_DEFAULT_MIN_LINES_PER_SECOND);
+
+    iterations = (argc >= 2) ? strtoul(argv[1], NULL, 10) : _FUZZ_DEFAULT_ITERATIONS;
+    memset(&source, 0, sizeof(source));
+    source.state = (argc >= 3) ? (unsigned int)strtoul(argv[2], NULL, 10) : (unsigned int)time(NULL);
+    if (source.state == 0)
+        source.state = 2463534242u;
+    if (_Fuzz_setup() != 0)
+        return 1;
+    printf("Differential fuzzing %lu program(s) with seed %u.\n", iterations, source.state);
+
+    r = 0;
+    for (i = 0; i < iterations && r == 0; i += 1)
+    {
+        length = _Fuzz_generate(&source, _fuzzProgram, sizeof(_fuzzProgram));
+        r = _Fuzz_check(_fuzzProgram, length, (i % 4 == 3) ? 1 + (int)(i / 4 % 2) : 0, "random program");
+        if (r != 0)
+            fprintf(stderr, "[ERROR] Program %lu differs, it is kept as 'differential-failure.asm'.\n", i);
+    }
+    if (r != 0)
+    {
+        FILE *f = fopen("differential-failure.asm", "wb");
+
+        if (f)
+        {
+            fwrite(_fuzzProgram, 1, length, f);
+            fclose(f);
+        }
+    }
+    else
+        printf("All %lu program(s) match the reference encoder.\n", iterations);
+    _Fuzz_cleanup();
+    return r;
+}
+
+#endif
+
+// ================================
+
+static unsigned int _Fuzz_next(FuzzSource_t *source, unsigned int bound)
+{
+    unsigned int x;
+
+    if (source->data != NULL)
+    {
+        if (source->position >= source->size)
+            return 0;
+        x = source->data[source->position++];
+        if (bound > 256 && source->position < source->size)
+            x = (x << 8) | source->data[source->position++];
+        return x % bound;
+    }
+    x = source->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    source->state = x;
+    return x % bound;
+}
+
+#define _FUZZ_EMIT(...) (length += (size_t)snprintf(program + length, size - length, __VA_ARGS__))
+
+static size_t _Fuzz_generate(FuzzSource_t *source, char *program, size_t size)
+{
+    static const char *indents[] = {"", "", "    ", "\t", "  \t"};
+    static const char *spaces[] = {"", "", "", " ", "  "};
+    static const char *comments[] = {"// comment", "//", "# note", "// (LOOP) @R0 D=M;JMP"};
+    static const char dests[] = "ADM";
+    char dest[4];
+    int defined[_FUZZ_LABEL_NAMES];
+    unsigned int lines, i, j, k, mask, order;
+    const char *space, *newline, *mnemonic;
+    size_t length;
+
+    memset(defined, 0, sizeof(defined));
+    length = 0;
+    lines = 1 + _Fuzz_next(source, _FUZZ_MAX_LINES);
+    newline = _Fuzz_next(source, 4) ? "\n" : "\r\n";
+    for (i = 0; i < lines && (source->data == NULL || source->position < source->size); i += 1)
+    {
+        _FUZZ_EMIT("%s", indents[_Fuzz_next(source, sizeof(indents) / sizeof(indents[0]))]);
+        space = spaces[_Fuzz_next(source, sizeof(spaces) / sizeof(spaces[0]))];
+        switch (_Fuzz_next(source, 20))
+        {
+        case 0:
+            break;
+        case 1:
+            _FUZZ_EMIT("%s", comments[_Fuzz_next(source, sizeof(comments) / sizeof(comments[0]))]);
+            break;
+        case 2:
+        case 3:
+            k = _Fuzz_next(source, _FUZZ_LABEL_NAMES);
+            if (defined[k])
+                continue;
+            defined[k] = 1;
+            _FUZZ_EMIT("(%s%s%s)", space, _fuzzLabels[k], space);
+            break;
+        case 4:
+        case 5:
+        case 6:
+            _FUZZ_EMIT("@%u", _Fuzz_next(source, 4) ? _Fuzz_next(source, 64) : _Fuzz_next(source, _FUZZ_LITERAL_MAX + 1));
+            break;
+        case 7:
+            _FUZZ_EMIT("@%s", _fuzzLabels[_Fuzz_next(source, _FUZZ_LABEL_NAMES)]);
+            break;
+        case 8:
+            _FUZZ_EMIT("@%s", _fuzzVariables[_Fuzz_next(source, sizeof(_fuzzVariables) / sizeof(_fuzzVariables[0]))]);
+            break;
+        case 9:
+            _FUZZ_EMIT("@%s", _fuzzBuiltin[_Fuzz_next(source, sizeof(_fuzzBuiltin) / sizeof(_fuzzBuiltin[0]))].mnemonic);
+            break;
+        case 10:
+            // Rare enough that most programs assemble
+            if (_Fuzz_next(source, 16) == 0)
+            {
+                _FUZZ_EMIT("%s", _fuzzInvalid[_Fuzz_next(source, sizeof(_fuzzInvalid) / sizeof(_fuzzInvalid[0]))]);
+                break;
+            }
+            /* fall through */
+        default:
+            // Any subset of the dest letters in any of the six orders, empty for no dest
+            mask = _Fuzz_next(source, 8);
+            k = _Fuzz_next(source, 6);
+            for (j = 0, dest[0] = '\0'; j < 3; j += 1)
+            {
+                order = (k < 3) ? (j + k) % 3 : (k - j) % 3;
+                if (mask & (1u << order))
+                    strncat(dest, dests + order, 1);
+            }
+            if (dest[0] != '\0')
+                _FUZZ_EMIT("%s%s=%s", dest, space, space);
+            mnemonic = _fuzzComp[_Fuzz_next(source, sizeof(_fuzzComp) / sizeof(_fuzzComp[0]))].mnemonic;
+            if (_Fuzz_next(source, 4) == 0 && (mnemonic[0] == '-' || mnemonic[0] == '!') && mnemonic[1] != '\0')
+                _FUZZ_EMIT("%c %s", mnemonic[0], mnemonic + 1);
+            else if (_Fuzz_next(source, 4) == 0 && strlen(mnemonic) == 3)
+                _FUZZ_EMIT("%c %c %c", mnemonic[0], mnemonic[1], mnemonic[2]);
+            else
+                _FUZZ_EMIT("%s", mnemonic);
+            if (dest[0] == '\0' || _Fuzz_next(source, 4) == 0)
+                _FUZZ_EMIT("%s;%s%s", space, space, _fuzzJump[_Fuzz_next(source, sizeof(_fuzzJump) / sizeof(_fuzzJump[0]))].mnemonic);
+            break;
+        }
+        if (_Fuzz_next(source, 6) == 0)
+            _FUZZ_EMIT("%s%s", spaces[3], comments[_Fuzz_next(source, sizeof(comments) / sizeof(comments[0]))]);
+        if (_Fuzz_next(source, 8) == 0)
+            _FUZZ_EMIT("  ");
+        if (i + 1 < lines || _Fuzz_next(source, 2))
+            _FUZZ_EMIT("%s", newline);
+    }
+    return length;
+}
+
+#undef _FUZZ_EMIT
+
+static void _Fuzz_trim(char *string)
+{
+    size_t start, end;
+
+    for (start = 0; string[start] == ' ' || string[start] == '\t'; start += 1)
+        ;
+    for (end = strlen(string); end > start && (string[end - 1] == ' ' || string[end - 1] == '\t' || string[end - 1] == '\r'); end -= 1)
+        ;
+    memmove(string, string + start, end - start);
+    string[end - start] = '\0';
+}
+
+static int _Fuzz_lookup(const FuzzMnemonic_t *table, size_t count, const char *mnemonic, unsigned int *bits)
+{
+    size_t i;
+
+    for (i = 0; i < count; i += 1)
+        if (strcmp(table[i].mnemonic, mnemonic) == 0)
+        {
+            *bits = table[i].bits;
+            return 0;
+        }
+    return 1;
+}
+
+/* Linear on purpose, the reference has to be obviously right rather than fast. */
+static const FuzzSymbol_t *_Fuzz_symbol(const FuzzSymbol_t *symbols, unsigned int count, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i += 1)
+        if (strcmp(symbols[i].name, name) == 0)
+            return symbols + i;
+    return NULL;
+}
+
+static int _Fuzz_encodeC(char *line, unsigned int *word)
+{
+    char *equal, *semicolon, *comp, *p, *q;
+    unsigned int bits, letters;
+
+    *word = 0xE000;
+    comp = line;
+    if ((equal = strchr(line, '=')) != NULL)
+    {
+        *equal = '\0';
+        _Fuzz_trim(line);
+        if (line[0] == '\0')
+            return 1;
+        for (p = line, letters = 0; *p; p += 1)
+        {
+            bits = (*p == 'A') ? 4 : (*p == 'D') ? 2 : (*p == 'M') ? 1 : 0;
+            if (bits == 0 || (letters & bits))
+                return 1;
+            letters |= bits;
+        }
+        *word |= letters << 3;
+        comp = equal + 1;
+    }
+    if ((semicolon = strchr(comp, ';')) != NULL)
+    {
+        *semicolon = '\0';
+        _Fuzz_trim(semicolon + 1);
+        if (_Fuzz_lookup(_fuzzJump, sizeof(_fuzzJump) / sizeof(_fuzzJump[0]), semicolon + 1, &bits))
+            return 1;
+        *word |= bits;
+    }
+    for (p = q = comp; *p; p += 1)
+        if (*p != ' ')
+            *q++ = *p;
+    *q = '\0';
+    if (_Fuzz_lookup(_fuzzComp, sizeof(_fuzzComp) / sizeof(_fuzzComp[0]), comp, &bits))
+        return 1;
+    *word |= bits << 6;
+    return 0;
+}
+
+/* Two passes over a copy of the program; returns nonzero if any line is invalid.
+   labels[i] tells whether word i is the address of a label. */
+static int _Fuzz_reference(char *program, unsigned short *words, unsigned char *labels, unsigned int *count)
+{
+    static FuzzSymbol_t symbols[_FUZZ_MAX_LINES * 2 + sizeof(_fuzzBuiltin) / sizeof(_fuzzBuiltin[0])];
+    const FuzzSymbol_t *symbol;
+    char line[_FUZZ_LINE_LENGTH];
+    char *p, *q, *end;
+    unsigned int symbolCount, address, variable, value, pass;
+    size_t length;
+
+    symbolCount = 0;
+    for (address = 0; address < sizeof(_fuzzBuiltin) / sizeof(_fuzzBuiltin[0]); address += 1)
+    {
+        strcpy(symbols[symbolCount].name, _fuzzBuiltin[address].mnemonic);
+        symbols[symbolCount].label = 0;
+        symbols[symbolCount++].address = _fuzzBuiltin[address].bits;
+    }
+
+    variable = _FUZZ_FIRST_VARIABLE;
+    for (pass = 1; pass <= 2; pass += 1)
+    {
+        *count = 0;
+        for (p = program; *p; p = (*end == '\n') ? end + 1 : end)
+        {
+            end = strchr(p, '\n');
+            if (end == NULL)
+                end = p + strlen(p);
+            length = (size_t)(end - p);
+            if (length >= sizeof(line))
+                return 1;
+            memcpy(line, p, length);
+            line[length] = '\0';
+            if ((q = strstr(line, "//")) != NULL)
+                *q = '\0';
+            if ((q = strchr(line, '#')) != NULL)
+                *q = '\0';
+            _Fuzz_trim(line);
+            if (line[0] == '\0')
+                continue;
+
+            if (line[0] == '(')
+            {
+                if ((q = strchr(line, ')')) == NULL)
+                    return 1;
+                *q = '\0';
+                _Fuzz_trim(line + 1);
+                if (pass == 1 && _Fuzz_symbol(symbols, symbolCount, line + 1) == NULL)
+                {
+                    strcpy(symbols[symbolCount].name, line + 1);
+                    symbols[symbolCount].label = 1;
+                    symbols[symbolCount++].address = *count;
+                }
+                continue;
+            }
+            labels[*count] = 0;
+            if (line[0] == '@')
+            {
+                if (line[1] >= '0' && line[1] <= '9')
+                {
+                    for (q = line + 1, value = 0; *q >= '0' && *q <= '9' && value <= _FUZZ_LITERAL_MAX; q += 1)
+                        value = value * 10 + (unsigned int)(*q - '0');
+                    if (*q != '\0' || value > _FUZZ_LITERAL_MAX)
+                        return 1;
+                }
+                else if (pass == 1)
+                    value = 0; // Labels may still be ahead
+                else if ((symbol = _Fuzz_symbol(symbols, symbolCount, line + 1)) != NULL)
+                {
+                    value = symbol->address;
+                    labels[*count] = (unsigned char)symbol->label;
+                }
+                else
+                {
+                    strcpy(symbols[symbolCount].name, line + 1);
+                    symbols[symbolCount].label = 0;
+                    symbols[symbolCount++].address = value = variable++;
+                }
+                words[*count] = (unsigned short)value;
+            }
+            else if (_Fuzz_encodeC(line, &value) != 0)
+                return 1;
+            else
+                words[*count] = (unsigned short)value;
+            *count += 1;
+        }
+    }
+    return 0;
+}
+
+/* The two linked copies from the words of one: the first ends with the entry label,
+   the second has its labels moved past the first and jumps back to the entry. */
+static void _Fuzz_link(unsigned short *words, const unsigned char *labels, unsigned int *count)
+{
+    unsigned int i, n;
+
+    n = *count;
+    for (i = 0; i < n; i += 1)
+        words[n + i] = (unsigned short)(labels[i] ? words[i] + n : words[i]);
+    words[2 * n] = (unsigned short)n;
+    words[2 * n + 1] = _FUZZ_JUMP;
+    *count = 2 * n + 2;
+}
+
+static int _Fuzz_write(const char *path, const char *program, size_t length, const char *trailer)
+{
+    FILE *f;
+    int r;
+
+    if ((f = fopen(path, "wb")) == NULL)
+        return 1;
+    r = fwrite(program, 1, length, f) != length || fputs(trailer, f) == EOF;
+    return (fclose(f) != 0 || r) ? 1 : 0;
+}
+
+/* Runs the assembler with stdout sent to the output file and reads the words back.
+   link is 0 to assemble directly, otherwise the number of objects to link. */
+static int _Fuzz_assemble(const char *program, size_t length, int link, unsigned short *words, unsigned int *count)
+{
+    char *compileArgv[] = {"assembler", "-c", _fuzzInputPath, _fuzzSecondPath, NULL};
+    char *linkArgv[] = {"assembler", "--link", _fuzzObjectPath, _fuzzSecondObjectPath, NULL};
+    char *assembleArgv[] = {"assembler", _fuzzInputPath, NULL};
+    char *asyncArgv[] = {"assembler", "--async-io", _fuzzInputPath, NULL};
+    static unsigned int plainRuns = 0;
+    char line[_FUZZ_LINE_LENGTH];
+    int savedOut, savedErr, fd, null, i;
+    unsigned int word;
+    FILE *f;
+
+    if (_Fuzz_write(_fuzzInputPath, program, length, (link == 2) ? "\n(" _FUZZ_ENTRY_LABEL ")\n" : "") != 0)
+        return 1;
+    if (link == 2 && _Fuzz_write(_fuzzSecondPath, program, length, "\n@" _FUZZ_ENTRY_LABEL "\n0;JMP\n") != 0)
+        return 1;
+    remove(_fuzzObjectPath);
+    remove(_fuzzSecondObjectPath);
+
+    if ((fd = open(_fuzzOutputPath, O_WRONLY | O_TRUNC)) < 0)
+        return 1;
+    null = open("/dev/null", O_WRONLY);
+    fflush(stdout);
+    fflush(stderr);
+    savedOut = dup(STDOUT_FILENO);
+    savedErr = dup(STDERR_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    if (link)
+    {
+        AssemblerMain(2 + link, compileArgv);
+        AssemblerMain(2 + link, linkArgv);
+    }
+    else if (plainRuns++ % 2)
+        AssemblerMain(3, asyncArgv);
+    else
+        AssemblerMain(2, assembleArgv);
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedOut, STDOUT_FILENO);
+    dup2(savedErr, STDERR_FILENO);
+    close(savedOut);
+    close(savedErr);
+    close(null);
+    close(fd);
+
+    if ((f = fopen(_fuzzOutputPath, "rb")) == NULL)
+        return 1;
+    *count = 0;
+    while (fgets(line, sizeof(line), f) != NULL && *count < _FUZZ_MAX_LINKED_WORDS)
+    {
+        for (i = 0, word = 0; i < 16 && (line[i] == '0' || line[i] == '1'); i += 1)
+            word = (word << 1) | (unsigned int)(line[i] - '0');
+        if (i != 16 || line[16] != '\n')
+        {
+            fclose(f);
+            return 1;
+        }
+        words[(*count)++] = (unsigned short)word;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int _Fuzz_check(const char *program, size_t length, int link, const char *label)
+{
+    static char copy[_FUZZ_PROGRAM_SIZE];
+    static unsigned short expected[_FUZZ_MAX_LINKED_WORDS], actual[_FUZZ_MAX_LINKED_WORDS];
+    static unsigned char labels[_FUZZ_MAX_WORDS];
+    unsigned int expectedCount, actualCount, i;
+    char a[17], b[17];
+    int j;
+
+    memcpy(copy, program, length);
+    copy[length] = '\0';
+    if (_Fuzz_reference(copy, expected, labels, &expectedCount) != 0)
+        expectedCount = 0; // Rejected, the assembler has to skip the file
+    else if (link == 2)
+        _Fuzz_link(expected, labels, &expectedCount);
+    if (_Fuzz_assemble(program, length, link, actual, &actualCount) != 0)
+    {
+        fprintf(stderr, "[ERROR] The assembler output for the %s is not a list of 16-bit words.\n", label);
+        return 1;
+    }
+
+    for (i = 0; i < expectedCount && i < actualCount; i += 1)
+        if (expected[i] != actual[i])
+            break;
+    if (i == expectedCount && i == actualCount)
+        return 0;
+    fprintf(stderr, "[ERROR] The %s%s gives %u word(s), the reference %u.\n", label, (link == 2) ? " (-c, --link, two objects)" : link ? " (-c, --link)" : "", actualCount, expectedCount);
+    if (i < expectedCount && i < actualCount)
+    {
+        for (j = 15; j >= 0; j -= 1)
+        {
+            a[15 - j] = (char)('0' + ((actual[i] >> j) & 1));
+            b[15 - j] = (char)('0' + ((expected[i] >> j) & 1));
+        }
+        a[16] = b[16] = '\0';
+        fprintf(stderr, "\tFirst difference at ROM address %u: %s, expected %s.\n", i, a, b);
+    }
+    return 1;
+}
+
+static int _Fuzz_setup(void)
+{
+    int fd;
+
+    if ((fd = mkstemps(_fuzzInputPath, 4)) < 0)
+        return 1;
+    close(fd);
+    if ((fd = mkstemps(_fuzzOutputPath, 4)) < 0)
+        return 1;
+    close(fd);
+    if ((fd = mkstemps(_fuzzSecondPath, 4)) < 0)
+        return 1;
+    close(fd);
+    strcpy(_fuzzObjectPath, _fuzzInputPath);
+    strcpy(strrchr(_fuzzObjectPath, '.'), ".hobj");
+    strcpy(_fuzzSecondObjectPath, _fuzzSecondPath);
+    strcpy(strrchr(_fuzzSecondObjectPath, '.'), ".hobj");
+    return 0;
+}
+
+static void _Fuzz_cleanup(void)
+{
+    remove(_fuzzInputPath);
+    remove(_fuzzObjectPath);
+    remove(_fuzzSecondPath);
+    remove(_fuzzSecondObjectPath);
+    remove(_fuzzOutputPath);
+}
+
+static int _Fuzz_throughput(const char *corpus, double minimum)
+{
+    char *argv[] = {"assembler", (char *)corpus, NULL};
+    struct timespec start, end;
+    double seconds, best, rate;
+    unsigned long lines;
+    int savedOut, savedErr, null, c, i;
+    FILE *f;
+
+    if ((f = fopen(corpus, "rb")) == NULL)
+    {
+        fprintf(stderr, "[ERROR] Cannot open the corpus '%s'.\n", corpus);
+        return 1;
+    }
+    for (lines = 0; (c = fgetc(f)) != EOF;)
+        lines += (c == '\n');
+    fclose(f);
+
+    best = 0.0;
+    null = open("/dev/null", O_WRONLY);
+    for (i = 0; i < _FUZZ_THROUGHPUT_RUNS; i += 1)
+    {
+        fflush(stdout);
+        fflush(stderr);
+        savedOut = dup(STDOUT_FILENO);
+        savedErr = dup(STDERR_FILENO);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        AssemblerMain(2, argv);
+        fflush(stdout);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        dup2(savedOut, STDOUT_FILENO);
+        dup2(savedErr, STDERR_FILENO);
+        close(savedOut);
+        close(savedErr);
+        seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+        if (i == 0 || seconds < best)
+            best = seconds;
+    }
+    close(null);
+
+    rate = (best > 0.0) ? (double)lines / best : 0.0;
+    printf("Assembled %lu line(s) in %.3f ms at best, %.0f lines/s (minimum %.0f).\n", lines, best * 1e3, rate, minimum);
+    if (rate < minimum)
+    {
+        fprintf(stderr, "[ERROR] Throughput is below the minimum of %.0f lines/s.\n", minimum);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+#include "instruction.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define _INSTRUCTION_STREAM_INITIAL_CAPACITY 4096
+#define _INSTRUCTION_STREAM_SPILL_BLOCK 1024 /* records buffered before a write */
+
+struct InstructionStream
+{
+    Instruction_t *instructions; // The whole stream while it is in memory
+    size_t count;
+    size_t capacity;
+    size_t cursor;
+    FILE *spill;                // Spill file, NULL while the stream is in memory
+    unsigned char *block;       // Spilled: records not written yet
+    size_t buffered;            // Spilled: number of records in the block
+    const unsigned char *map;   // Spilled: read-only view of the file, set by Rewind
+    size_t mapped;              // Spilled: records covered by the view
+    Instruction_t current;      // Spilled: the record Next() decoded last
+};
+
+static int _InstructionStreamResize(InstructionStream_t *stream, size_t capacity);
+static void _InstructionStreamEncode(unsigned char *record, const Instruction_t *instruction);
+static int _InstructionStreamFlush(InstructionStream_t *stream);
+static void _InstructionStreamUnmap(InstructionStream_t *stream);
+
+InstructionStream_t *InstructionStreamCreate(void)
+{
+    InstructionStream_t *stream;
+
+    stream = (InstructionStream_t *)calloc(1, sizeof(*stream));
+    return stream;
+}
+
+InstructionStream_t *InstructionStreamDestroy(InstructionStream_t *stream)
+{
+    if (stream)
+    {
+        MemoryReleased(MEMORY_INSTRUCTION, stream->capacity * sizeof(*stream->instructions));
+        free(stream->instructions);
+        if (stream->spill)
+        {
+            MemoryReleased(MEMORY_INSTRUCTION, _INSTRUCTION_STREAM_SPILL_BLOCK * INSTRUCTION_RECORD_SIZE);
+            free(stream->block);
+            _InstructionStreamUnmap(stream);
+            fclose(stream->spill);
+        }
+    }
+    free(stream);
+    return NULL;
+}
+
+int InstructionStreamAppend(InstructionStream_t *stream, unsigned int kind, unsigned int operand, unsigned int line)
+{
+    Instruction_t *instruction;
+    size_t capacity;
+    int r;
+
+    if (stream->spill == NULL && stream->count == stream->capacity)
+    {
+        capacity = stream->capacity ? stream->capacity * 2 : _INSTRUCTION_STREAM_INITIAL_CAPACITY;
+        // Over the budget the stream goes to the spill file instead of growing
+        if (!MemoryFits((capacity - stream->capacity) * sizeof(*instruction)))
+            r = InstructionStreamSpill(stream);
+        else
+            r = _InstructionStreamResize(stream, capacity);
+        if (r != 0)
+            return r;
+    }
+
+    instruction = stream->spill ? &stream->current : stream->instructions + stream->count;
+    instruction->operand = operand;
+    instruction->kind = kind;
+    instruction->line = (line > INSTRUCTION_MAX_LINE) ? INSTRUCTION_MAX_LINE : line;
+    stream->count += 1;
+    if (stream->spill == NULL)
+        return 0;
+
+    _InstructionStreamEncode(stream->block + stream->buffered * INSTRUCTION_RECORD_SIZE, instruction);
+    if ((stream->buffered += 1) == _INSTRUCTION_STREAM_SPILL_BLOCK)
+        return _InstructionStreamFlush(stream);
+    return 0;
+}
+
+int InstructionStreamRewind(InstructionStream_t *stream)
+{
+    void *map;
+
+    stream->cursor = 0;
+    if (stream->spill == NULL || stream->mapped == stream->count)
+        return 0;
+
+    // Appended since the last view, map the whole file again
+    _InstructionStreamUnmap(stream);
+    if (_InstructionStreamFlush(stream) != 0 || fflush(stream->spill) != 0)
+        return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    if (stream->count == 0)
+        return 0;
+    map = mmap(NULL, stream->count * INSTRUCTION_RECORD_SIZE, PROT_READ, MAP_PRIVATE, fileno(stream->spill), 0);
+    if (map == MAP_FAILED)
+        return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    madvise(map, stream->count * INSTRUCTION_RECORD_SIZE, MADV_SEQUENTIAL);
+    stream->map = (const unsigned char *)map;
+    stream->mapped = stream->count;
+    return 0;
+}
+
+const Instruction_t *InstructionStreamNext(InstructionStream_t *stream)
+{
+    const unsigned char *record;
+    unsigned int word;
+
+    if (stream->spill == NULL)
+        return (stream->cursor == stream->count) ? NULL : stream->instructions + (stream->cursor)++;
+    if (stream->cursor == stream->mapped)
+        return NULL;
+
+    record = stream->map + (stream->cursor)++ * INSTRUCTION_RECORD_SIZE;
+    stream->current.operand = (unsigned int)record[0] | ((unsigned int)record[1] << 8) | ((unsigned int)record[2] << 16) | ((unsigned int)record[3] << 24);
+    word = (unsigned int)record[4] | ((unsigned int)record[5] << 8) | ((unsigned int)record[6] << 16) | ((unsigned int)record[7] << 24);
+    stream->current.kind = word & 3u;
+    stream->current.line = word >> 2;
+    return &stream->current;
+}
+
+size_t InstructionStreamCount(const InstructionStream_t *stream)
+{
+    return stream->count;
+}
+
+int InstructionStreamReset(InstructionStream_t *stream)
+{
+    stream->count = 0;
+    stream->cursor = 0;
+    if (stream->spill == NULL)
+        return 0;
+    _InstructionStreamUnmap(stream);
+    stream->buffered = 0;
+    if (fflush(stream->spill) != 0 || ftruncate(fileno(stream->spill), 0) != 0 || fseek(stream->spill, 0, SEEK_SET) != 0)
+        return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    return 0;
+}
+
+/* Moves what is in memory to a temporary file; appends go through one block from then on. */
+int InstructionStreamSpill(InstructionStream_t *stream)
+{
+    size_t i;
+
+    if (stream->spill != NULL)
+        return 0;
+    if ((stream->block = (unsigned char *)malloc(_INSTRUCTION_STREAM_SPILL_BLOCK * INSTRUCTION_RECORD_SIZE)) == NULL)
+        return INSTRUCTION_STREAM_ERROR_NO_MEMORY;
+    if ((stream->spill = tmpfile()) == NULL)
+    {
+        free(stream->block);
+        stream->block = NULL;
+        return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    }
+    MemoryAllocated(MEMORY_INSTRUCTION, _INSTRUCTION_STREAM_SPILL_BLOCK * INSTRUCTION_RECORD_SIZE);
+
+    for (i = 0; i < stream->count; i += 1)
+    {
+        _InstructionStreamEncode(stream->block + stream->buffered * INSTRUCTION_RECORD_SIZE, stream->instructions + i);
+        if ((stream->buffered += 1) == _INSTRUCTION_STREAM_SPILL_BLOCK && _InstructionStreamFlush(stream) != 0)
+            return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    }
+    MemoryReleased(MEMORY_INSTRUCTION, stream->capacity * sizeof(*stream->instructions));
+    free(stream->instructions);
+    stream->instructions = NULL;
+    stream->capacity = 0;
+    return 0;
+}
+
+int InstructionStreamSpilled(const InstructionStream_t *stream)
+{
+    return stream->spill != NULL;
+}
+
+// ================================
+
+static int _InstructionStreamResize(InstructionStream_t *stream, size_t capacity)
+{
+    Instruction_t *instructions;
+
+    instructions = (Instruction_t *)realloc(stream->instructions, capacity * sizeof(*instructions));
+    if (instructions == NULL)
+        return INSTRUCTION_STREAM_ERROR_NO_MEMORY;
+    MemoryAllocated(MEMORY_INSTRUCTION, (capacity - stream->capacity) * sizeof(*instructions));
+    stream->instructions = instructions;
+    stream->capacity = capacity;
+    return 0;
+}
+
+static void _InstructionStreamEncode(unsigned char *record, const Instruction_t *instruction)
+{
+    unsigned int word = (unsigned int)instruction->kind | ((unsigned int)instruction->line << 2);
+
+    record[0] = (unsigned char)(instruction->operand & 0xFF);
+    record[1] = (unsigned char)((instruction->operand >> 8) & 0xFF);
+    record[2] = (unsigned char)((instruction->operand >> 16) & 0xFF);
+    record[3] = (unsigned char)((instruction->operand >> 24) & 0xFF);
+    record[4] = (unsigned char)(word & 0xFF);
+    record[5] = (unsigned char)((word >> 8) & 0xFF);
+    record[6] = (unsigned char)((word >> 16) & 0xFF);
+    record[7] = (unsigned char)((word >> 24) & 0xFF);
+}
+
+static int _InstructionStreamFlush(InstructionStream_t *stream)
+{
+    size_t n = stream->buffered;
+
+    stream->buffered = 0;
+    if (n && fwrite(stream->block, INSTRUCTION_RECORD_SIZE, n, stream->spill) != n)
+        return INSTRUCTION_STREAM_ERROR_CANNOT_SPILL;
+    return 0;
+}
+
+static void _InstructionStreamUnmap(InstructionStream_t *stream)
+{
+    if (stream->map != NULL)
+        munmap((void *)stream->map, stream->mapped * INSTRUCTION_RECORD_SIZE);
+    stream->map = NULL;
+    stream->mapped = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _INSTRUCTION_H_LOADED
+#define _INSTRUCTION_H_LOADED
+
+#include <stddef.h>
+
+/* Instruction kinds, operand meaning in parentheses */
+#define INSTRUCTION_A_LITERAL 0 /* constant value */
+#define INSTRUCTION_A_SYMBOL 1  /* symbol ID */
+#define INSTRUCTION_C 2         /* encoded 16-bit word */
+#define INSTRUCTION_LABEL 3     /* symbol ID, takes no ROM space */
+
+#define INSTRUCTION_MAX_LINE ((1u << 30) - 1)
+
+typedef struct
+{
+    unsigned int operand;
+    unsigned int kind : 2;
+    unsigned int line : 30;
+} Instruction_t;
+
+/* Sequential stream of instructions: appended during pass 1, read back in order afterwards.
+   The pointer returned by InstructionStreamNext() is valid until the next call.
+
+   When the memory budget does not allow it to grow, or once InstructionStreamSpill() is
+   called, the stream moves to a temporary file of fixed-width records written in order.
+   Rewind maps the file read-only and Next decodes one record at a time.
+
+   Record (little-endian, INSTRUCTION_RECORD_SIZE bytes):
+       operand (32-bit), kind | line << 2 (32-bit).
+*/
+typedef struct InstructionStream InstructionStream_t;
+
+#define INSTRUCTION_RECORD_SIZE 8
+
+InstructionStream_t *InstructionStreamCreate(void);
+InstructionStream_t *InstructionStreamDestroy(InstructionStream_t *stream);
+int InstructionStreamAppend(InstructionStream_t *stream, unsigned int kind, unsigned int operand, unsigned int line);
+int InstructionStreamRewind(InstructionStream_t *stream);
+const Instruction_t *InstructionStreamNext(InstructionStream_t *stream);
+size_t InstructionStreamCount(const InstructionStream_t *stream);
+/* Empty the stream for the next file, keeping its buffer or spill file. */
+int InstructionStreamReset(InstructionStream_t *stream);
+int InstructionStreamSpill(InstructionStream_t *stream);
+int InstructionStreamSpilled(const InstructionStream_t *stream);
+
+#define INSTRUCTION_STREAM_ERROR_NO_MEMORY 1
+#define INSTRUCTION_STREAM_ERROR_CANNOT_SPILL 2
+
+#endif
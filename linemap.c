@@ -0,0 +1,155 @@
+#include "linemap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _LINE_MAP_COUNT_OFFSET 8
+
+static FILE *_lineMapFile = NULL;
+static unsigned int _lastAddress;
+static unsigned int _lastLine;
+static unsigned int _entryCount;
+static int _writeError;
+static char **_sourceNames = NULL;
+static unsigned int _sourceCount;
+static unsigned int _lastSource;
+
+static void _LineMapWriteUInt32(unsigned int value);
+static int _LineMapSource(const char *source, unsigned int *index);
+static void _LineMapFreeSources(void);
+static void _LineMapWriteVarint(unsigned int value);
+
+int LineMapOpen(const char *filename)
+{
+    if (_lineMapFile)
+        return LINE_MAP_ERROR_ALREADY_OPENED;
+
+    _lineMapFile = fopen(filename, "wb");
+    if (_lineMapFile == NULL)
+        return LINE_MAP_ERROR_CANNOT_OPEN;
+
+    _lastAddress = 0;
+    _lastLine = 0;
+    _entryCount = 0;
+    _writeError = 0;
+    _sourceCount = 0;
+    _lastSource = 0;
+    fwrite("HLMP", 1, 4, _lineMapFile);
+    _LineMapWriteUInt32(LINE_MAP_VERSION);
+    _LineMapWriteUInt32(0);
+    _LineMapWriteUInt32(0);
+    return 0;
+}
+
+int LineMapAdd(unsigned int address, const char *source, unsigned int line)
+{
+    unsigned int index;
+    int lineDelta;
+
+    if (_lineMapFile == NULL)
+        return LINE_MAP_ERROR_FILE_CLOSED;
+    if (_LineMapSource(source, &index) != 0)
+        return LINE_MAP_ERROR_NO_MEMORY;
+
+    lineDelta = (int)(line - _lastLine);
+    _LineMapWriteVarint(address - _lastAddress);
+    _LineMapWriteVarint(((unsigned int)lineDelta << 1) ^ (unsigned int)(lineDelta >> 31));
+    _LineMapWriteVarint(index);
+    _lastAddress = address;
+    _lastLine = line;
+    _entryCount += 1;
+    return _writeError ? LINE_MAP_ERROR_CANNOT_WRITE : 0;
+}
+
+int LineMapClose(void)
+{
+    unsigned int i;
+    FILE *f;
+
+    if (_lineMapFile == NULL)
+        return LINE_MAP_ERROR_FILE_CLOSED;
+
+    for (i = 0; i < _sourceCount; i += 1)
+        if (fwrite(_sourceNames[i], 1, strlen(_sourceNames[i]) + 1, _lineMapFile) != strlen(_sourceNames[i]) + 1)
+            _writeError = 1;
+
+    // The counts are only known now, patch them into the header
+    if (fseek(_lineMapFile, _LINE_MAP_COUNT_OFFSET, SEEK_SET) != 0)
+        _writeError = 1;
+    else
+    {
+        _LineMapWriteUInt32(_entryCount);
+        _LineMapWriteUInt32(_sourceCount);
+    }
+    _LineMapFreeSources();
+
+    f = _lineMapFile;
+    _lineMapFile = NULL;
+    if (fclose(f) != 0)
+        _writeError = 1;
+    return _writeError ? LINE_MAP_ERROR_CANNOT_WRITE : 0;
+}
+
+// ================================
+
+static void _LineMapWriteUInt32(unsigned int value)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char)(value & 0xFF);
+    bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+    bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+    bytes[3] = (unsigned char)((value >> 24) & 0xFF);
+    if (fwrite(bytes, 1, 4, _lineMapFile) != 4)
+        _writeError = 1;
+}
+
+static void _LineMapWriteVarint(unsigned int value)
+{
+    while (value >= 0x80)
+    {
+        if (putc((int)((value & 0x7F) | 0x80), _lineMapFile) == EOF)
+            _writeError = 1;
+        value >>= 7;
+    }
+    if (putc((int)value, _lineMapFile) == EOF)
+        _writeError = 1;
+}
+
+/* Nearly every entry has the source of the one before it. */
+static int _LineMapSource(const char *source, unsigned int *index)
+{
+    char **names;
+    unsigned int i;
+
+    if (_sourceCount && strcmp(_sourceNames[_lastSource], source) == 0)
+    {
+        *index = _lastSource;
+        return 0;
+    }
+    for (i = 0; i < _sourceCount; i += 1)
+        if (strcmp(_sourceNames[i], source) == 0)
+        {
+            *index = _lastSource = i;
+            return 0;
+        }
+    if ((names = (char **)realloc(_sourceNames, (_sourceCount + 1) * sizeof(*names))) == NULL)
+        return LINE_MAP_ERROR_NO_MEMORY;
+    _sourceNames = names;
+    if ((names[_sourceCount] = strdup(source)) == NULL)
+        return LINE_MAP_ERROR_NO_MEMORY;
+    *index = _lastSource = _sourceCount++;
+    return 0;
+}
+
+static void _LineMapFreeSources(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < _sourceCount; i += 1)
+        free(_sourceNames[i]);
+    free(_sourceNames);
+    _sourceNames = NULL;
+    _sourceCount = 0;
+}
@@ -0,0 +1,30 @@
+#ifndef _LINE_MAP_H_LOADED
+#define _LINE_MAP_H_LOADED
+
+/*
+    Source line to ROM address map, written while pass 2 emits instructions.
+
+    Format:
+        magic "HLMP", version, entry count, source count (little-endian 32-bit
+            unsigned integers),
+        entries { address delta, line delta, source }, LEB128 varints,
+            the address delta unsigned, the line delta zigzag-encoded signed,
+            the source an index into the names,
+        source names, each terminated by '\0', in index order.
+    Both deltas are relative to the previous entry, starting from address 0 and line 0.
+    Lines are those of the included file or macro body the instruction came from.
+*/
+
+#define LINE_MAP_VERSION 2
+
+int LineMapOpen(const char *filename);
+int LineMapAdd(unsigned int address, const char *source, unsigned int line);
+int LineMapClose(void);
+
+#define LINE_MAP_ERROR_ALREADY_OPENED 1
+#define LINE_MAP_ERROR_CANNOT_OPEN 2
+#define LINE_MAP_ERROR_FILE_CLOSED 3
+#define LINE_MAP_ERROR_CANNOT_WRITE 4
+#define LINE_MAP_ERROR_NO_MEMORY 5
+
+#endif
@@ -1,207 +1,1009 @@
 #include "code.h"
+#include "cpu.h"
+#include "diagnostic.h"
+#include "instruction.h"
+#include "linemap.h"
+#include "memory.h"
+#include "object.h"
 #include "parser.h"
+#include "peephole.h"
+#include "pipeline.h"
+#include "preprocessor.h"
+#include "symbolmap.h"
 #include "symboltable.h"
+#include "translate.h"
 
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define _MAIN_FIRST_VARIABLE_ADDRESS 16
+#define _MAIN_LAST_VARIABLE_ADDRESS 16383 /* SCREEN starts right after */
+#define _MAIN_OUTPUT_BUFFER_SIZE 65536
+#define _MAIN_MANIFEST_LINE_LENGTH 2048
+#define _MAIN_WORD_BATCH 2048
+
+typedef struct
+{
+    const char *symbolsPath;
+    int symbolsFormat;
+    const char *lineMapPath;
+    int addressWidth;
+    int optimize;
+    int compileOnly;
+    int link;
+    unsigned int maxErrors; /* 0 for no limit */
+    int diagnosticsFormat;
+    int stats;
+    int spill;
+    int asyncIo;
+    const char *manifestPath;
+    int run;
+    unsigned long runCycles;
+    int ramDump; /* 0 for the non-zero words only */
+    unsigned int ramDumpFirst;
+    unsigned int ramDumpLast;
+    const char *emitCPath;
+} MainOptions_t;
+
+// One line per word adds up, stdout is fully buffered in a buffer of our own
+static char _mainOutputBuffer[_MAIN_OUTPUT_BUFFER_SIZE];
+static int _mainOutputBuffered = 0;
+// Manifest outputs are written one at a time, they share a second buffer
+static char _mainFileBuffer[_MAIN_OUTPUT_BUFFER_SIZE];
+static int _mainFileBufferAccounted = 0;
+// Words are formatted in batches straight into one text block
+static unsigned short _mainWords[_MAIN_WORD_BATCH];
+static char _mainWordText[_MAIN_WORD_BATCH * CODE_WORD_TEXT_LENGTH];
+static unsigned int _mainWordCount = 0;
+// Sticky, a batch that failed to flush fails the whole program
+static int _mainWordError = 0;
+// With --async-io the text blocks go to a writer thread instead of fwrite()
+static PipelineWriter_t *_mainWriter = NULL;
+// With --run or --emit-c the words are loaded into the CPU instead of being written
+static int _mainLoading = 0;
+
+static int _MainParseOption(MainOptions_t *options, const char *option);
+static int _MainAssembleFile(const MainOptions_t *options, const char *filename, FILE *output, InstructionStream_t **stream, int *skipped);
+static int _MainManifest(const MainOptions_t *options, const char *manifest, InstructionStream_t **stream, int *failed);
+static unsigned int _MainInstructionSize(const MainOptions_t *options, unsigned int kind, unsigned int operand);
+static int _MainFirstPass(const MainOptions_t *options, const char *filename, InstructionStream_t *stream);
+static int _MainError(const char *filename, unsigned int line, unsigned int column, int code, const char *subject);
+static void _MainPreprocessorError(char *buffer, size_t size);
+static int _MainAllocateVariables(const char *filename);
+static int _MainOptimize(const MainOptions_t *options, const char *filename, InstructionStream_t **stream);
+static void _MainAssignLabelAddresses(const MainOptions_t *options, InstructionStream_t *stream);
+static int _MainSecondPass(const MainOptions_t *options, const char *filename, FILE *output, InstructionStream_t *stream);
+static void _MainLocate(const char *filename, unsigned int position, const char **source, unsigned int *line);
+static void _MainEmitWord(FILE *output, unsigned int word);
+static int _MainFlushWords(FILE *output);
+static void _MainOpenWriter(const MainOptions_t *options, FILE *output);
+static int _MainCloseWriter(void);
+static int _MainRun(const MainOptions_t *options, const char *filename, FILE *output);
+static int _MainEmitC(const MainOptions_t *options, const char *filename);
+static int _MainWriteObject(const char *filename, InstructionStream_t *stream);
+static int _MainLink(const MainOptions_t *options, int argc, char **argv);
 
 int main(int argc, char **argv)
 {
-    char bitString[16];
-    const char *bitStrings[3];
-    const char *_symbol, *_dest, *_comp, *_jump;
-    unsigned int lineCount, variableAddressCount, instructionAddressCount;
-    int i, r, t;
-    int error, pass;
-    int inputValue;
+    MainOptions_t options;
+    InstructionStream_t *stream;
+    int i, r, manifests, inputs, skipped, failed;
 
+    memset(&options, 0, sizeof(options));
+    options.addressWidth = CODE_ADDRESS_BITS;
+    options.maxErrors = 1;
+    options.diagnosticsFormat = DIAGNOSTIC_FORMAT_TEXT;
     for (i = 1; i < argc; i += 1)
+        if (argv[i][0] == '-' && _MainParseOption(&options, argv[i]) != 0)
+        {
+            fprintf(stderr, "[ERROR] Unknown option '%s'.\n", argv[i]);
+            return 1;
+        }
+    for (i = 1, manifests = (options.manifestPath != NULL), inputs = 0; i < argc; i += 1)
+    {
+        manifests += (argv[i][0] == '@');
+        inputs += (argv[i][0] != '@' && argv[i][0] != '-');
+    }
+    // Each of these writes one fixed path, a second file would overwrite it
+    if (!options.link && (manifests || inputs > 1) && (options.symbolsPath != NULL || options.lineMapPath != NULL || options.emitCPath != NULL))
+    {
+        fprintf(stderr, "[ERROR] Options --symbols, --symbols-text, --line-map and --emit-c take a single input file and no manifest.\n");
+        return 1;
+    }
+    if ((options.compileOnly || options.link) && (options.addressWidth != CODE_ADDRESS_BITS || options.lineMapPath != NULL || manifests || (options.compileOnly && options.link)))
+    {
+        fprintf(stderr, "[ERROR] Options -c and --link do not combine with each other, --address-width, --line-map or a manifest.\n");
+        return 1;
+    }
+    if (options.compileOnly && (options.run || options.emitCPath != NULL))
+    {
+        fprintf(stderr, "[ERROR] Options --run and --emit-c do not combine with -c, use them on the linked program with --link.\n");
+        return 1;
+    }
+    _mainLoading = options.run || options.emitCPath != NULL;
+    ParserSetLiteralMax((int)((1u << options.addressWidth) - 1));
+    PreprocessorSetReadAhead(options.asyncIo);
+    if (!_mainOutputBuffered && setvbuf(stdout, _mainOutputBuffer, _IOFBF, sizeof(_mainOutputBuffer)) == 0)
     {
-        if ((r = SymbolTableInit()) != 0)
+        MemoryAllocated(MEMORY_OUTPUT, sizeof(_mainOutputBuffer));
+        _mainOutputBuffered = 1;
+    }
+    if (options.link)
+    {
+        r = _MainLink(&options, argc, argv);
+        CpuExit();
+        if (options.stats)
+            MemoryReport(stderr);
+        return r;
+    }
+
+    // One symbol table and one stream serve every file, they are reset in between
+    if ((r = SymbolTableInit()) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module SymbolTable failed to initialize (%d).\n", r);
+        return 1;
+    }
+    if ((stream = InstructionStreamCreate()) == NULL || (options.spill && (r = InstructionStreamSpill(stream)) != 0))
+    {
+        fprintf(stderr, "[ERROR] Module Instruction failed to create a stream (%d).\n", stream ? r : INSTRUCTION_STREAM_ERROR_NO_MEMORY);
+        InstructionStreamDestroy(stream);
+        SymbolTableExit();
+        return 1;
+    }
+
+    r = failed = 0;
+    for (i = 1; i < argc && r == 0; i += 1)
+        if (argv[i][0] == '@')
+            r = _MainManifest(&options, argv[i] + 1, &stream, &failed);
+        else if (argv[i][0] != '-')
         {
-            fprintf(stderr, "[ERROR] Module SymbolTable failed to initialize (%d).\n", r);
+            r = _MainAssembleFile(&options, argv[i], stdout, &stream, &skipped);
+            failed |= skipped;
+        }
+    if (r == 0 && options.manifestPath != NULL)
+        r = _MainManifest(&options, options.manifestPath, &stream, &failed);
+    InstructionStreamDestroy(stream);
+    SymbolTableExit();
+    CpuExit();
+    PreprocessorClearCache();
+    if (DiagnosticCount() && DiagnosticEmit(stderr, options.diagnosticsFormat) != 0)
+        fprintf(stderr, "[ERROR] Module Diagnostic failed to write %u error(s).\n", DiagnosticCount());
+    DiagnosticClear();
+    if (options.stats)
+        MemoryReport(stderr);
+
+    // A build has to see the files and manifest entries that did not make it
+    return (r != 0 || failed) ? 1 : 0;
+}
+
+static int _MainParseOption(MainOptions_t *options, const char *option)
+{
+    const char *value;
+    char *end;
+    long number;
+    size_t size;
+
+    if ((value = strchr(option, '=')) != NULL)
+        value += 1;
+
+    if (strncmp(option, "--symbols=", 10) == 0)
+    {
+        options->symbolsPath = value;
+        options->symbolsFormat = SYMBOL_MAP_FORMAT_BINARY;
+    }
+    else if (strncmp(option, "--symbols-text=", 15) == 0)
+    {
+        options->symbolsPath = value;
+        options->symbolsFormat = SYMBOL_MAP_FORMAT_TEXT;
+    }
+    else if (strncmp(option, "--line-map=", 11) == 0)
+        options->lineMapPath = value;
+    else if (strcmp(option, "-O") == 0)
+        options->optimize = 1;
+    else if (strncmp(option, "--max-errors=", 13) == 0)
+    {
+        number = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || number < 0)
+            return 1;
+        options->maxErrors = (unsigned int)number;
+    }
+    else if (strcmp(option, "--diagnostics-format=text") == 0)
+        options->diagnosticsFormat = DIAGNOSTIC_FORMAT_TEXT;
+    else if (strcmp(option, "--diagnostics-format=json") == 0)
+        options->diagnosticsFormat = DIAGNOSTIC_FORMAT_JSON;
+    else if (strcmp(option, "--stats") == 0)
+        options->stats = 1;
+    else if (strcmp(option, "--spill") == 0)
+        options->spill = 1;
+    else if (strcmp(option, "--async-io") == 0)
+        options->asyncIo = 1;
+    else if (strcmp(option, "--run") == 0)
+    {
+        options->run = 1;
+        options->runCycles = CPU_DEFAULT_CYCLES;
+    }
+    else if (strncmp(option, "--run=", 6) == 0)
+    {
+        options->run = 1;
+        options->runCycles = strtoul(value, &end, 10);
+        if (*value == '\0' || *value == '-' || *end != '\0' || options->runCycles == 0)
             return 1;
+    }
+    else if (strncmp(option, "--ram-dump=", 11) == 0)
+    {
+        options->ramDump = 1;
+        if (sscanf(value, "%u-%u", &options->ramDumpFirst, &options->ramDumpLast) != 2 || options->ramDumpFirst > options->ramDumpLast)
+            return 1;
+    }
+    else if (strncmp(option, "--emit-c=", 9) == 0 && *value != '\0')
+        options->emitCPath = value;
+    else if (strncmp(option, "--manifest=", 11) == 0 && *value != '\0')
+        options->manifestPath = value;
+    else if (strncmp(option, "--max-memory=", 13) == 0)
+    {
+        if (MemoryParseSize(value, &size) != 0)
+            return 1;
+        MemorySetBudget(size);
+    }
+    else if (strcmp(option, "-c") == 0)
+        options->compileOnly = 1;
+    else if (strcmp(option, "--link") == 0)
+        options->link = 1;
+    else if (strncmp(option, "--address-width=", 16) == 0)
+    {
+        number = strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || number < CODE_ADDRESS_BITS || number > CODE_FAR_ADDRESS_BITS)
+            return 1;
+        options->addressWidth = (int)number;
+    }
+    else
+        return 1;
+    return 0;
+}
+
+/* One file through both passes into output; a file with errors is reported and skipped.
+   Returns non-zero only when the shared state cannot be reset for the next file. */
+static int _MainAssembleFile(const MainOptions_t *options, const char *filename, FILE *output, InstructionStream_t **stream, int *skipped)
+{
+    int error, pass, r;
+
+    pass = 1;
+    error = _MainFirstPass(options, filename, *stream);
+    if (!error)
+    {
+        fprintf(stderr, "[INFO] Module Parser has finished parsing file '%s' with pass = %d.\n", filename, pass);
+        pass += 1;
+        // Objects keep undefined symbols as imports, the linker decides what becomes a variable
+        if (!options->compileOnly)
+            error = _MainAllocateVariables(filename);
+    }
+    if (!error && options->optimize)
+        error = _MainOptimize(options, filename, stream);
+    if (!error && options->compileOnly)
+        error = _MainWriteObject(filename, *stream);
+    else if (!error)
+        error = _MainSecondPass(options, filename, output, *stream);
+    if (!error && options->emitCPath != NULL)
+        error = _MainEmitC(options, filename);
+    if (!error && options->run)
+        error = _MainRun(options, filename, output);
+
+    if (options->stats && InstructionStreamSpilled(*stream))
+        fprintf(stderr, "[INFO] Module Instruction kept the %lu instruction(s) of file '%s' in a temporary file.\n", (unsigned long)InstructionStreamCount(*stream), filename);
+    if (error)
+        fprintf(stderr, "[WARNING] Skipping the file '%s' that failed to parse with pass = %d.\n", filename, pass);
+    else if (options->symbolsPath != NULL && (r = SymbolMapWrite(options->symbolsPath, options->symbolsFormat)) != 0)
+        fprintf(stderr, "[WARNING] Module Symbol Map failed to write '%s' for file '%s' (%d).\n", options->symbolsPath, filename, r);
+    *skipped = error;
+
+    if ((r = InstructionStreamReset(*stream)) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Instruction failed to reset the stream after file '%s' (%d).\n", filename, r);
+        return 1;
+    }
+    if ((r = SymbolTableReset()) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module SymbolTable failed to reset after file '%s' (%d).\n", filename, r);
+        return 1;
+    }
+    return 0;
+}
+
+/* --manifest=FILE and @FILE: one "input output" pair per line, blank lines and lines
+   starting with '#' are skipped. The output of a skipped input is removed.
+   Sets *failed when the manifest cannot be read or any of its entries fails. */
+static int _MainManifest(const MainOptions_t *options, const char *manifest, InstructionStream_t **stream, int *failed)
+{
+    char line[_MAIN_MANIFEST_LINE_LENGTH];
+    char input[_MAIN_MANIFEST_LINE_LENGTH], outputPath[_MAIN_MANIFEST_LINE_LENGTH];
+    unsigned int lineCount, files, assembled;
+    FILE *f, *output;
+    char extra;
+    int n, r, skipped;
+
+    if ((f = fopen(manifest, "r")) == NULL)
+    {
+        fprintf(stderr, "[ERROR] Cannot open the manifest '%s'.\n", manifest);
+        *failed = 1;
+        return 0;
+    }
+
+    r = 0;
+    lineCount = files = assembled = 0;
+    while (r == 0 && fgets(line, sizeof(line), f) != NULL)
+    {
+        lineCount += 1;
+        if (strchr(line, '\n') == NULL && !feof(f))
+        {
+            fprintf(stderr, "[ERROR] Line %u of the manifest '%s' is too long.\n", lineCount, manifest);
+            while (fgets(line, sizeof(line), f) != NULL && strchr(line, '\n') == NULL)
+                ;
+            *failed = 1;
+            continue;
         }
-        pass = 1;
-        variableAddressCount = 15;
-        instructionAddressCount = 0;
-    main_pass_loop:
-        if ((r = ParserInit(argv[i])) != 0)
+        n = sscanf(line, "%2047s %2047s %c", input, outputPath, &extra);
+        if (n <= 0 || input[0] == '#')
+            continue;
+        if (n != 2)
         {
-            fprintf(stderr, "[WARNING] Module Parser failed to parse file '%s' (%d).\n", argv[i], r);
+            fprintf(stderr, "[ERROR] Line %u of the manifest '%s' is not an input and an output path.\n", lineCount, manifest);
+            *failed = 1;
             continue;
         }
 
-        error = 0;
-        lineCount = 1;
-        while (hasMoreCommands())
+        files += 1;
+        if ((output = fopen(outputPath, "w")) == NULL)
+        {
+            fprintf(stderr, "[ERROR] Cannot open the output '%s' for file '%s'.\n", outputPath, input);
+            *failed = 1;
+            continue;
+        }
+        if (setvbuf(output, _mainFileBuffer, _IOFBF, sizeof(_mainFileBuffer)) == 0 && !_mainFileBufferAccounted)
+        {
+            MemoryAllocated(MEMORY_OUTPUT, sizeof(_mainFileBuffer));
+            _mainFileBufferAccounted = 1;
+        }
+        r = _MainAssembleFile(options, input, output, stream, &skipped);
+        if (fclose(output) != 0 && !skipped)
+        {
+            fprintf(stderr, "[ERROR] Failed to write the output '%s' for file '%s'.\n", outputPath, input);
+            skipped = 1;
+        }
+        if (skipped)
         {
-            switch (r = advance())
+            remove(outputPath);
+            *failed = 1;
+        }
+        else
+            assembled += 1;
+    }
+    if (ferror(f))
+    {
+        fprintf(stderr, "[ERROR] Failed to read the manifest '%s' after line %u.\n", manifest, lineCount);
+        *failed = 1;
+    }
+    fclose(f);
+    fprintf(stderr, "[INFO] Assembled %u of the %u file(s) listed in the manifest '%s'.\n", assembled, files, manifest);
+    return r;
+}
+
+/* ROM words taken by an instruction. Wider than 15 bits, symbols always take the
+   far form because their values are not known yet when addresses are assigned. */
+static unsigned int _MainInstructionSize(const MainOptions_t *options, unsigned int kind, unsigned int operand)
+{
+    if (kind == INSTRUCTION_LABEL)
+        return 0;
+    if (kind == INSTRUCTION_C || options->addressWidth <= CODE_ADDRESS_BITS)
+        return 1;
+    if (kind == INSTRUCTION_A_LITERAL && operand <= CODE_ADDRESS_MAX)
+        return 1;
+    return 2;
+}
+
+/* Parse the file once: encode C-instructions, intern every symbol and define the labels.
+   Errors are recorded and parsing goes on until options->maxErrors of them are found. */
+static int _MainFirstPass(const MainOptions_t *options, const char *filename, InstructionStream_t *stream)
+{
+    char text[512];
+    const char *bitStrings[3];
+    const char *_symbol, *_dest, *_comp, *_jump, *source;
+    unsigned int lineCount, position, column, instructionAddressCount, romSize, word, errors;
+    int r, t, id;
+    int fatal;
+    int inputValue;
+
+    if ((r = ParserInit(filename)) != 0)
+    {
+        fprintf(stderr, "[WARNING] Module Parser failed to parse file '%s' (%d).\n", filename, r);
+        return 1;
+    }
+
+    errors = 0;
+    fatal = 0;
+    lineCount = position = 0;
+    source = filename;
+    instructionAddressCount = 0;
+    romSize = 1u << options->addressWidth;
+    while (hasMoreCommands())
+    {
+        r = advance();
+        // Errors point into the included file or macro body, the stream keeps the position
+        lineCount = ParserLineNumber();
+        if ((source = PreprocessorSourceName()) == NULL)
+            source = filename;
+        position = PreprocessorPosition();
+        column = ParserColumn();
+        switch (r)
+        {
+        case 0:
+            switch (t = commandType())
             {
-            case 0:
-                switch (t = commandType())
+            case A_COMMAND:
+                _symbol = symbol();
+                if (_symbol == NULL)
                 {
-                case A_COMMAND:
-                    _symbol = symbol();
-                    if (_symbol == NULL)
-                    {
-                        error = 1;
-                        fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tSymbol is NULL (A).\n", argv[i], lineCount);
-                        break;
-                    }
-                    if (pass == 1)
-                        instructionAddressCount += 1;
-                    else
-                    {
-                        if (sscanf(_symbol, "%d", &inputValue) == 1)
-                        {
-                            Code_int2bitString(bitString, inputValue);
-                            fprintf(stdout, "0%s\n", bitString);
-                        }
-                        else if (contains(_symbol))
-                        {
-                            inputValue = GetAddress(_symbol);
-                            fprintf(stderr, "[INFO] Module Symbol Table retrieve symbol '%s' with address %d on line %u.\n", _symbol, inputValue, lineCount);
-                            Code_int2bitString(bitString, inputValue);
-                            fprintf(stdout, "0%s\n", bitString);
-                        }
-                        else if ((r = addEntry(_symbol, variableAddressCount += 1)) != 0)
-                        {
-                            error = 1;
-                            fprintf(stderr, "[ERROR] Module Symbol Table failed to add the symbol(var) '%s' on line %u\n\tFile '%s'.\n", _symbol, lineCount, argv[i]);
-                        }
-                        else
-                        {
-                            fprintf(stderr, "[INFO] Module Symbol Table add symbol '%s' with variable address %d on line %u.\n", _symbol, variableAddressCount, lineCount);
-                            Code_int2bitString(bitString, variableAddressCount);
-                            fprintf(stdout, "0%s\n", bitString);
-                        }
-                    }
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_EMPTY_SYMBOL, "A");
                     break;
-                case C_COMMAND:
-                    if (pass == 1)
-                        instructionAddressCount += 1;
-                    else
-                    {
-                        _dest = dest();
-                        _comp = comp();
-                        _jump = jump();
-                        bitStrings[1] = Code_comp(_comp);
-
-                        if (!_dest)
-                            bitStrings[0] = "000";
-                        else
-                            bitStrings[0] = Code_dest(_dest);
-                        if (!_comp)
-                        {
-                            error = 1;
-                            fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tcomp is NULL.\n", argv[i], lineCount);
-                            break;
-                        }
-                        if (!_jump)
-                            bitStrings[2] = "000";
-                        else
-                            bitStrings[2] = Code_jump(_jump);
-                        if (!bitStrings[0])
-                        {
-                            error = 1;
-                            fprintf(stderr, "[ERROR] Module Code failed to turn dest '%s' to bit string on line %u.\n", _dest, lineCount);
-                            break;
-                        }
-                        if (!bitStrings[1])
-                        {
-                            error = 1;
-                            fprintf(stderr, "[ERROR] Module Code failed to turn comp '%s' to bit string on line %u.\n", _comp, lineCount);
-                            break;
-                        }
-                        if (!bitStrings[2])
-                        {
-                            error = 1;
-                            fprintf(stderr, "[ERROR] Module Code failed to turn jump '%s' to bit string on line %u.\n", _jump, lineCount);
-                            break;
-                        }
-                        fprintf(stdout, "111%s%s%s\n", bitStrings[1], bitStrings[0], bitStrings[2]);
-                    }
+                }
+                if ((r = literal(&inputValue)) == PARSER_LITERAL_MALFORMED)
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_MALFORMED_CONSTANT, _symbol);
                     break;
-                case L_COMMAND:
-                    _symbol = symbol();
-                    if (_symbol == NULL)
-                    {
-                        error = 1;
-                        fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tSymbol is NULL (L).\n", argv[i], lineCount);
-                        break;
-                    }
-                    if (pass == 1)
-                    {
-                        if (contains(_symbol))
-                        {
-                            fprintf(stderr, "[WARNING] Module Symbol Table detected duplicated symbols '%s' on line %u.\n", _symbol, lineCount);
-                        }
-                        else
-                        {
-                            if (addEntry(_symbol, instructionAddressCount) != 0)
-                            {
-                                error = 1;
-                                fprintf(stderr, "[ERROR] Module Symbol Table failed to add the symbol(label) '%s' on line %u\n\tFile '%s'.\n", _symbol, lineCount, argv[i]);
-                            }
-                            else
-                                fprintf(stderr, "[INFO] Module Symbol Table add symbol '%s' with instruction address %d on %u line(s).\n", _symbol, instructionAddressCount, lineCount);
-                        }
-                    }
+                }
+                else if (r == PARSER_LITERAL_OUT_OF_RANGE)
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_CONSTANT_OUT_OF_RANGE, _symbol);
                     break;
-                default:
-                    error = 1;
-                    fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tUnknown command type: %d.\n", argv[i], lineCount, t);
+                }
+                else if (r == PARSER_LITERAL_DECIMAL)
+                {
+                    r = InstructionStreamAppend(stream, INSTRUCTION_A_LITERAL, (unsigned int)inputValue, position);
+                    instructionAddressCount += _MainInstructionSize(options, INSTRUCTION_A_LITERAL, (unsigned int)inputValue);
+                }
+                else if ((id = SymbolTableIntern(_symbol)) < 0)
+                {
+                    errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_SYMBOL_TABLE, _symbol);
                     break;
                 }
+                else
+                {
+                    r = InstructionStreamAppend(stream, INSTRUCTION_A_SYMBOL, (unsigned int)id, position);
+                    instructionAddressCount += _MainInstructionSize(options, INSTRUCTION_A_SYMBOL, (unsigned int)id);
+                }
+                if (r != 0)
+                    errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_NO_MEMORY, "");
                 break;
-            case PARSER_ERROR_FILE_CLOSED:
-                error = 1;
-                fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' with unexpected error code (%d, FILE NOT OPENED) on line %u.\n", argv[i], r, lineCount);
-                break;
-            case PARSER_ERROR_EOF_REACHED:
-                fprintf(stderr, "[INFO] Module Parser reach EOF parsing file '%s' after %u line(s).\n", argv[i], lineCount);
-                break;
-            case PARSER_ERROR_CANNOT_READ:
-                error = 1;
-                fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tI/O read error, error code from OS: %d.\n", argv[i], lineCount, errno);
-                break;
-            case PARSER_ERROR_EMPTY_LINE:
-                fprintf(stderr, "[INFO] Module Parser detected an empty line parsing file '%s' on line %u.\n", argv[i], lineCount);
+            case C_COMMAND:
+                _dest = dest();
+                _comp = comp();
+                _jump = jump();
+                bitStrings[1] = Code_comp(_comp);
+
+                if (!_dest)
+                    bitStrings[0] = "000";
+                else
+                    bitStrings[0] = Code_dest(_dest);
+                if (!_comp)
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_EMPTY_COMP, "");
+                    break;
+                }
+                if (!_jump)
+                    bitStrings[2] = "000";
+                else
+                    bitStrings[2] = Code_jump(_jump);
+                if (!bitStrings[0])
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_UNKNOWN_DEST, _dest);
+                    break;
+                }
+                if (!bitStrings[1])
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_UNKNOWN_COMP, _comp);
+                    break;
+                }
+                if (!bitStrings[2])
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_UNKNOWN_JUMP, _jump);
+                    break;
+                }
+                word = 0xE000 | (Code_bitString2int(bitStrings[1]) << 6) | (Code_bitString2int(bitStrings[0]) << 3) | Code_bitString2int(bitStrings[2]);
+                if (InstructionStreamAppend(stream, INSTRUCTION_C, word, position) != 0)
+                {
+                    errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_NO_MEMORY, "");
+                    break;
+                }
+                instructionAddressCount += _MainInstructionSize(options, INSTRUCTION_C, word);
                 break;
-            case PARSER_ERROR_LINE_TOO_LONG:
-                error = 1;
-                fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' on line %u:\n\tToo much character on a single line.\n", argv[i], lineCount);
+            case L_COMMAND:
+                _symbol = symbol();
+                if (_symbol == NULL)
+                {
+                    errors += _MainError(source, lineCount, column, DIAGNOSTIC_EMPTY_SYMBOL, "L");
+                    break;
+                }
+                if ((id = SymbolTableIntern(_symbol)) < 0)
+                    errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_SYMBOL_TABLE, _symbol);
+                else if (SymbolTableKind(id) != SYMBOL_KIND_UNDEFINED)
+                    fprintf(stderr, "[WARNING] Module Symbol Table detected duplicated symbols '%s' on line %u.\n", _symbol, lineCount);
+                else if (SymbolTableDefine(id, (int)instructionAddressCount, SYMBOL_KIND_LABEL) != 0 || InstructionStreamAppend(stream, INSTRUCTION_LABEL, (unsigned int)id, position) != 0)
+                    errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_SYMBOL_TABLE, _symbol);
+                else
+                    fprintf(stderr, "[INFO] Module Symbol Table add symbol '%s' with instruction address %u on %u line(s).\n", _symbol, instructionAddressCount, lineCount);
                 break;
             default:
-                error = 1;
-                fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' with unexpected error code (%d) on line %u.\n", argv[i], r, lineCount);
+                snprintf(text, sizeof(text), "command type %d", t);
+                errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_INTERNAL, text);
                 break;
             }
-            if (error)
+            break;
+        case PARSER_ERROR_EOF_REACHED:
+            fprintf(stderr, "[INFO] Module Parser reach EOF parsing file '%s' after %u line(s), %u of them blank or comments.\n", filename, lineCount, ParserSkippedLines());
+            break;
+        case PARSER_ERROR_CANNOT_READ:
+            snprintf(text, sizeof(text), "%d", errno);
+            errors += fatal = _MainError(source, lineCount, 0, DIAGNOSTIC_READ_ERROR, text);
+            break;
+        case PARSER_ERROR_EMPTY_LINE:
+            fprintf(stderr, "[INFO] Module Parser detected an empty line parsing file '%s' on line %u.\n", source, lineCount);
+            break;
+        case PARSER_ERROR_LINE_TOO_LONG:
+            errors += _MainError(source, lineCount, column, DIAGNOSTIC_LINE_TOO_LONG, "");
+            break;
+        case PARSER_ERROR_PREPROCESSOR:
+            _MainPreprocessorError(text, sizeof(text));
+            errors += fatal = _MainError(source, lineCount, 0, DIAGNOSTIC_PREPROCESSOR, text);
+            break;
+        default:
+            snprintf(text, sizeof(text), "parser error code %d", r);
+            errors += fatal = _MainError(source, lineCount, 0, DIAGNOSTIC_INTERNAL, text);
+            break;
+        }
+        if (!fatal && instructionAddressCount > romSize)
+        {
+            snprintf(text, sizeof(text), "%u", romSize);
+            errors += fatal = _MainError(source, lineCount, column, DIAGNOSTIC_ROM_OVERFLOW, text);
+        }
+        if (fatal || (options->maxErrors && errors >= options->maxErrors))
+            break;
+    }
+    if (errors)
+        fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s' with %u error(s).\n", filename, errors);
+    ParserExit();
+    return errors ? 1 : 0;
+}
+
+/* Record an error of the current file, always returns 1 so that callers can count it. */
+static int _MainError(const char *filename, unsigned int line, unsigned int column, int code, const char *subject)
+{
+    if (DiagnosticAdd(filename, line, column, code, subject) != 0)
+        fprintf(stderr, "[ERROR] Module Diagnostic ran out of memory recording an error on line %u of file '%s'.\n", line, filename);
+    return 1;
+}
+
+static void _MainPreprocessorError(char *buffer, size_t size)
+{
+    static const char *messages[] = {
+        "Unexpected error",
+        "Already opened",
+        "Cannot open",
+        "File closed",
+        "EOF reached",
+        "I/O read error",
+        "Out of memory",
+        "Malformed directive",
+        "Cannot include",
+        "Includes or macros nested too deeply",
+        "Macro defined twice",
+        "Wrong number of macro arguments",
+        "Macro is missing #endmacro",
+        "#endmacro without #macro",
+    };
+    const char *source, *subject;
+    unsigned int line;
+    int r;
+
+    r = PreprocessorLastError(&source, &line, &subject);
+    if (r < 0 || r >= (int)(sizeof(messages) / sizeof(messages[0])))
+        r = 0;
+    snprintf(buffer, size, "%s '%s' (%s line %u)", messages[r], subject, source, line);
+}
+
+/* Symbols still undefined after pass 1 are variables; IDs are in first-use order. */
+static int _MainAllocateVariables(const char *filename)
+{
+    unsigned int id, n;
+    int variableAddressCount;
+
+    variableAddressCount = _MAIN_FIRST_VARIABLE_ADDRESS;
+    n = SymbolTableCount();
+    for (id = 0; id < n; id += 1)
+    {
+        if (SymbolTableKind((int)id) != SYMBOL_KIND_UNDEFINED)
+            continue;
+        if (variableAddressCount > _MAIN_LAST_VARIABLE_ADDRESS)
+        {
+            fprintf(stderr, "[ERROR] Module Symbol Table has no RAM left below SCREEN for the symbol(var) '%s'\n\tFile '%s'.\n", SymbolTableName((int)id), filename);
+            return 1;
+        }
+        if (SymbolTableDefine((int)id, variableAddressCount, SYMBOL_KIND_VARIABLE) != 0)
+        {
+            fprintf(stderr, "[ERROR] Module Symbol Table failed to add the symbol(var) '%s'\n\tFile '%s'.\n", SymbolTableName((int)id), filename);
+            return 1;
+        }
+        fprintf(stderr, "[INFO] Module Symbol Table add symbol '%s' with variable address %d.\n", SymbolTableName((int)id), variableAddressCount);
+        variableAddressCount += 1;
+    }
+    return 0;
+}
+
+/* Run the peephole pass into a fresh stream, then move the labels to their new addresses. */
+static int _MainOptimize(const MainOptions_t *options, const char *filename, InstructionStream_t **stream)
+{
+    InstructionStream_t *optimized;
+    unsigned int removed;
+    int r;
+
+    if ((optimized = InstructionStreamCreate()) == NULL || (options->spill && (r = InstructionStreamSpill(optimized)) != 0))
+    {
+        fprintf(stderr, "[ERROR] Module Instruction failed to create a stream (%d).\n", optimized ? r : INSTRUCTION_STREAM_ERROR_NO_MEMORY);
+        InstructionStreamDestroy(optimized);
+        return 1;
+    }
+    if ((r = PeepholeOptimize(*stream, optimized, &removed)) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Peephole failed to optimize file '%s' (%d).\n", filename, r);
+        InstructionStreamDestroy(optimized);
+        return 1;
+    }
+    fprintf(stderr, "[INFO] Module Peephole removed %u instruction(s) from file '%s'.\n", removed, filename);
+
+    InstructionStreamDestroy(*stream);
+    *stream = optimized;
+    _MainAssignLabelAddresses(options, optimized);
+    return 0;
+}
+
+static void _MainAssignLabelAddresses(const MainOptions_t *options, InstructionStream_t *stream)
+{
+    const Instruction_t *instruction;
+    unsigned int instructionAddressCount;
+
+    instructionAddressCount = 0;
+    InstructionStreamRewind(stream);
+    while ((instruction = InstructionStreamNext(stream)) != NULL)
+    {
+        if (instruction->kind == INSTRUCTION_LABEL)
+            SymbolTableSetAddress((int)instruction->operand, (int)instructionAddressCount);
+        else
+            instructionAddressCount += _MainInstructionSize(options, instruction->kind, instruction->operand);
+    }
+}
+
+/* Resolve symbol IDs by index and emit the words; no text is parsed again. */
+static int _MainSecondPass(const MainOptions_t *options, const char *filename, FILE *output, InstructionStream_t *stream)
+{
+    const Instruction_t *instruction;
+    const char *source;
+    char bitString[17];
+    unsigned int instructionAddressCount, value, size, line;
+    int r, lineMap;
+
+    // -1 without a line map, then 0 or the first error of the map
+    lineMap = -1;
+    if (options->lineMapPath != NULL && (lineMap = LineMapOpen(options->lineMapPath)) != 0)
+    {
+        fprintf(stderr, "[WARNING] Module Line Map failed to open '%s' for file '%s' (%d).\n", options->lineMapPath, filename, lineMap);
+        lineMap = -1;
+    }
+
+    instructionAddressCount = 0;
+    if (_mainLoading)
+        CpuClear();
+    if ((r = InstructionStreamRewind(stream)) != 0)
+        fprintf(stderr, "[ERROR] Module Instruction failed to read back the instructions of file '%s' (%d).\n", filename, r);
+    else
+        r = 0;
+    _MainOpenWriter(options, output);
+    while ((instruction = InstructionStreamNext(stream)) != NULL)
+    {
+        switch (instruction->kind)
+        {
+        case INSTRUCTION_A_LITERAL:
+        case INSTRUCTION_A_SYMBOL:
+            if (instruction->kind == INSTRUCTION_A_LITERAL)
+                value = instruction->operand;
+            else
+                value = (unsigned int)SymbolTableAddress((int)instruction->operand);
+            size = _MainInstructionSize(options, instruction->kind, instruction->operand);
+            if (value >= (1u << options->addressWidth))
             {
-                fprintf(stderr, "[ERROR] Module Parser failed to parse file '%s'.\n", argv[i]);
+                snprintf(bitString, sizeof(bitString), "%u", value);
+                _MainLocate(filename, instruction->line, &source, &line);
+                r = _MainError(source, line, 0, DIAGNOSTIC_ADDRESS_OUT_OF_RANGE, bitString);
                 break;
-                ;
             }
-            lineCount += 1;
+            if (size > 1)
+                _MainEmitWord(output, Code_farPrefix(value));
+            _MainEmitWord(output, value & CODE_ADDRESS_MAX);
+            break;
+        case INSTRUCTION_C:
+            size = 1;
+            _MainEmitWord(output, instruction->operand);
+            break;
+        default:
+            continue;
         }
-        ParserExit();
-        if (error)
+        if (r != 0)
+            break;
+        if (lineMap == 0)
         {
-            fprintf(stderr, "[WARNING] Skipping the file '%s' that failed to parse with pass = %d.\n", argv[i], pass);
-            SymbolTableExit();
+            _MainLocate(filename, instruction->line, &source, &line);
+            lineMap = LineMapAdd(instructionAddressCount, source, line);
+        }
+        instructionAddressCount += size;
+    }
+    if ((_MainFlushWords(output) | _MainCloseWriter()) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Assembler failed to %s the program of file '%s'.\n", _mainLoading ? "load" : "write", filename);
+        r = 1;
+    }
+
+    // A map missing entries would still read as complete, drop it
+    if (lineMap == 0)
+        lineMap = LineMapClose();
+    else if (lineMap > 0)
+        LineMapClose();
+    if (lineMap > 0)
+    {
+        fprintf(stderr, "[WARNING] Module Line Map failed to write '%s' for file '%s' (%d).\n", options->lineMapPath, filename, lineMap);
+        remove(options->lineMapPath);
+    }
+    return r;
+}
+
+/* Source and line of an instruction from the position pass 1 gave it. */
+static void _MainLocate(const char *filename, unsigned int position, const char **source, unsigned int *line)
+{
+    if (PreprocessorLocate(position, source, line) != 0)
+    {
+        *source = filename;
+        *line = position;
+    }
+}
+
+static void _MainEmitWord(FILE *output, unsigned int word)
+{
+    if (_mainWordCount == _MAIN_WORD_BATCH)
+        _MainFlushWords(output);
+    _mainWords[_mainWordCount++] = (unsigned short)word;
+}
+
+/* Non-zero if this or any earlier batch since _MainOpenWriter() failed. */
+static int _MainFlushWords(FILE *output)
+{
+    size_t length;
+    int r;
+
+    if (_mainLoading)
+    {
+        length = _mainWordCount;
+        _mainWordCount = 0;
+        r = CpuLoad(_mainWords, length);
+    }
+    else
+    {
+        length = Code_formatWords(_mainWordText, _mainWords, _mainWordCount);
+        _mainWordCount = 0;
+        if (_mainWriter != NULL)
+            r = PipelineWriterWrite(_mainWriter, _mainWordText, length);
+        else
+            r = (fwrite(_mainWordText, 1, length, output) != length) ? 1 : 0;
+    }
+    if (r != 0)
+        _mainWordError = 1;
+    return _mainWordError;
+}
+
+/* Starts a program, clearing the flush error. Falls back to writing on the calling
+   thread when the writer cannot start. */
+static void _MainOpenWriter(const MainOptions_t *options, FILE *output)
+{
+    _mainWordError = 0;
+    if (options->asyncIo && !_mainLoading && (_mainWriter = PipelineWriterOpen(output)) != NULL)
+        MemoryAllocated(MEMORY_OUTPUT, PIPELINE_BUFFER_BYTES);
+}
+
+static int _MainCloseWriter(void)
+{
+    int r;
+
+    if (_mainWriter == NULL)
+        return 0;
+    r = PipelineWriterClose(_mainWriter);
+    _mainWriter = NULL;
+    MemoryReleased(MEMORY_OUTPUT, PIPELINE_BUFFER_BYTES);
+    return r;
+}
+
+/* --run: execute what the second pass loaded, the report replaces the program text. */
+static int _MainRun(const MainOptions_t *options, const char *filename, FILE *output)
+{
+    CpuResult_t result;
+    int r;
+
+    if ((r = CpuRun(options->runCycles, &result)) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module CPU failed to run file '%s' (%d).\n", filename, r);
+        return 1;
+    }
+    fprintf(stderr, "[INFO] Module CPU ran file '%s' for %lu cycle(s) over %lu word(s), stop: %s.\n", filename, result.cycles, (unsigned long)CpuRomSize(), CpuStopName(result.stop));
+    if (options->ramDump)
+        r = CpuReport(output, &result, options->ramDumpFirst, options->ramDumpLast, 0);
+    else
+        r = CpuReport(output, &result, 0, CPU_RAM_SIZE - 1, 1);
+    if (r != 0)
+    {
+        fprintf(stderr, "[ERROR] Module CPU failed to write the report of file '%s' (%d).\n", filename, r);
+        return 1;
+    }
+    return 0;
+}
+
+/* --emit-c=FILE: translate what the second pass loaded into a C simulator. */
+static int _MainEmitC(const MainOptions_t *options, const char *filename)
+{
+    int r;
+
+    if ((r = TranslateWriteC(options->emitCPath, filename, CpuRom(), CpuRomSize())) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Translator failed to write '%s' for file '%s' (%d).\n", options->emitCPath, filename, r);
+        return 1;
+    }
+    fprintf(stderr, "[INFO] Module Translator wrote '%s' for file '%s', %lu word(s).\n", options->emitCPath, filename, (unsigned long)CpuRomSize());
+    return 0;
+}
+
+/* -c: write 'name.hobj' next to 'name.asm' instead of emitting the program. */
+static int _MainWriteObject(const char *filename, InstructionStream_t *stream)
+{
+    const char *dot, *slash;
+    char *path;
+    size_t length;
+    int r;
+
+    dot = strrchr(filename, '.');
+    slash = strrchr(filename, '/');
+    length = (dot != NULL && (slash == NULL || dot > slash)) ? (size_t)(dot - filename) : strlen(filename);
+    if ((path = (char *)malloc(length + sizeof(".hobj"))) == NULL)
+    {
+        fprintf(stderr, "[ERROR] Module Object failed to write an object for file '%s' (%d).\n", filename, OBJECT_ERROR_NO_MEMORY);
+        return 1;
+    }
+    memcpy(path, filename, length);
+    strcpy(path + length, ".hobj");
+
+    if ((r = ObjectWrite(path, stream)) != 0)
+        fprintf(stderr, "[ERROR] Module Object failed to write '%s' for file '%s' (%d).\n", path, filename, r);
+    else
+        fprintf(stderr, "[INFO] Module Object wrote '%s' for file '%s'.\n", path, filename);
+    free(path);
+    return r ? 1 : 0;
+}
+
+/* --link: place the objects one after another in argument order, export the labels
+   that other objects import, turn imports nobody exports into variables, then patch
+   the relocated words. Labels nobody imports stay local to their object. */
+static int _MainLink(const MainOptions_t *options, int argc, char **argv)
+{
+    static const char linkedName[] = "(linked program)";
+
+    Object_t **objects;
+    const char **paths;
+    const ObjectSymbol_t *objectSymbol;
+    const ObjectRelocation_t *relocation;
+    unsigned int *bases;
+    unsigned int romSize, j;
+    int count, i, k, id, r, error;
+
+    objects = (Object_t **)calloc((size_t)argc, sizeof(*objects));
+    bases = (unsigned int *)malloc((size_t)argc * sizeof(*bases));
+    paths = (const char **)malloc((size_t)argc * sizeof(*paths));
+    if (objects == NULL || bases == NULL || paths == NULL || (r = SymbolTableInit()) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Linker failed to initialize.\n");
+        free(objects);
+        free(bases);
+        free(paths);
+        return 1;
+    }
+
+    error = 0;
+    count = 0;
+    romSize = 0;
+    for (i = 1; i < argc && !error; i += 1)
+    {
+        if (argv[i][0] == '-')
             continue;
+        if ((r = ObjectRead(argv[i], &objects[count])) != 0)
+        {
+            error = 1;
+            fprintf(stderr, "[ERROR] Module Object failed to read '%s' (%d).\n", argv[i], r);
+            break;
         }
-        if (pass < 2)
+        bases[count] = romSize;
+        paths[count] = argv[i];
+        romSize += objects[count]->wordCount;
+        if (romSize > (1u << CODE_ADDRESS_BITS))
         {
-            fprintf(stderr, "[INFO] Module Parser has finished parsing file '%s' with pass = %d.\n", argv[i], pass);
-            pass += 1;
-            goto main_pass_loop;
+            error = 1;
+            fprintf(stderr, "[ERROR] Module Linker cannot fit '%s' into the %u-word ROM.\n", argv[i], 1u << CODE_ADDRESS_BITS);
+            break;
         }
-        SymbolTableExit();
+        count += 1;
     }
 
-    return 0;
+    // Imports first, in link order; a label is exported only if its name was imported
+    for (k = 0; k < count && !error; k += 1)
+        for (j = 0; j < objects[k]->symbolCount && !error; j += 1)
+            if (objects[k]->symbols[j].kind == OBJECT_SYMBOL_IMPORT && SymbolTableIntern(objects[k]->symbols[j].name) < 0)
+            {
+                error = 1;
+                fprintf(stderr, "[ERROR] Module Symbol Table failed to add the symbol '%s'.\n", objects[k]->symbols[j].name);
+            }
+    for (k = 0; k < count && !error; k += 1)
+        for (j = 0; j < objects[k]->symbolCount && !error; j += 1)
+        {
+            objectSymbol = objects[k]->symbols + j;
+            if (objectSymbol->kind != OBJECT_SYMBOL_LABEL || (id = SymbolTableFind(objectSymbol->name)) < 0)
+                continue;
+            if (SymbolTableDefine(id, (int)(bases[k] + objectSymbol->address), SYMBOL_KIND_LABEL) != 0)
+            {
+                error = 1;
+                fprintf(stderr, "[ERROR] Module Linker cannot export the label '%s' of '%s', another object defines it too.\n", objectSymbol->name, paths[k]);
+            }
+        }
+    if (!error)
+        error = _MainAllocateVariables(linkedName);
+
+    _MainOpenWriter(options, stdout);
+    for (k = 0; k < count && !error; k += 1)
+    {
+        for (j = 0; j < objects[k]->relocationCount; j += 1)
+        {
+            relocation = objects[k]->relocations + j;
+            objectSymbol = objects[k]->symbols + relocation->symbol;
+            if (objectSymbol->kind == OBJECT_SYMBOL_LABEL)
+                objects[k]->words[relocation->word] = (unsigned short)(bases[k] + objectSymbol->address);
+            else
+                objects[k]->words[relocation->word] = (unsigned short)SymbolTableAddress(SymbolTableFind(objectSymbol->name));
+        }
+        for (j = 0; j < objects[k]->wordCount; j += 1)
+            _MainEmitWord(stdout, objects[k]->words[j]);
+    }
+    if ((_MainFlushWords(stdout) | _MainCloseWriter()) != 0)
+    {
+        fprintf(stderr, "[ERROR] Module Linker failed to %s the linked program.\n", _mainLoading ? "load" : "write");
+        error = 1;
+    }
+    if (!error && options->emitCPath != NULL)
+        error = _MainEmitC(options, linkedName);
+    if (!error && options->run)
+        error = _MainRun(options, linkedName, stdout);
+
+    if (!error)
+    {
+        fprintf(stderr, "[INFO] Module Linker linked %d object(s) into %u word(s).\n", count, romSize);
+        if (options->symbolsPath != NULL && (r = SymbolMapWrite(options->symbolsPath, options->symbolsFormat)) != 0)
+            fprintf(stderr, "[WARNING] Module Symbol Map failed to write '%s' for the linked program (%d).\n", options->symbolsPath, r);
+    }
+    for (k = 0; k < count; k += 1)
+        ObjectFree(objects[k]);
+    free(objects);
+    free(bases);
+    free(paths);
+    SymbolTableExit();
+    return error;
 }
@@ -0,0 +1,105 @@
+#include "memory.h"
+
+#include <stdlib.h>
+
+static const char *_memoryCategoryNames[MEMORY_CATEGORY_COUNT] = {"Parser", "Preprocessor", "Symbol Table", "Instruction", "Output", "CPU"};
+
+static size_t _memoryInUse[MEMORY_CATEGORY_COUNT];
+static size_t _memoryPeak[MEMORY_CATEGORY_COUNT];
+static size_t _memoryTotal = 0;
+static size_t _memoryTotalPeak = 0;
+static size_t _memoryBudget = 0;
+
+void MemoryAllocated(int category, size_t bytes)
+{
+    if ((_memoryInUse[category] += bytes) > _memoryPeak[category])
+        _memoryPeak[category] = _memoryInUse[category];
+    if ((_memoryTotal += bytes) > _memoryTotalPeak)
+        _memoryTotalPeak = _memoryTotal;
+}
+
+void MemoryReleased(int category, size_t bytes)
+{
+    // A mismatched release must not wrap the counters around
+    bytes = (bytes > _memoryInUse[category]) ? _memoryInUse[category] : bytes;
+    _memoryInUse[category] -= bytes;
+    _memoryTotal -= bytes;
+}
+
+size_t MemoryInUse(int category)
+{
+    return (category == MEMORY_TOTAL) ? _memoryTotal : _memoryInUse[category];
+}
+
+size_t MemoryPeak(int category)
+{
+    return (category == MEMORY_TOTAL) ? _memoryTotalPeak : _memoryPeak[category];
+}
+
+void MemorySetBudget(size_t bytes)
+{
+    _memoryBudget = bytes;
+}
+
+size_t MemoryBudget(void)
+{
+    return _memoryBudget;
+}
+
+int MemoryFits(size_t bytes)
+{
+    return _memoryBudget == 0 || (bytes <= _memoryBudget && _memoryTotal <= _memoryBudget - bytes);
+}
+
+int MemoryParseSize(const char *text, size_t *bytes)
+{
+    unsigned long long value;
+    unsigned int shift;
+    char *end;
+
+    if (*text < '0' || *text > '9')
+        return MEMORY_ERROR_MALFORMED_SIZE;
+    value = strtoull(text, &end, 10);
+    switch (*end)
+    {
+    case '\0':
+        shift = 0;
+        break;
+    case 'k':
+    case 'K':
+        shift = 10;
+        break;
+    case 'm':
+    case 'M':
+        shift = 20;
+        break;
+    case 'g':
+    case 'G':
+        shift = 30;
+        break;
+    default:
+        return MEMORY_ERROR_MALFORMED_SIZE;
+    }
+    if (*end != '\0' && end[1] != '\0')
+        return MEMORY_ERROR_MALFORMED_SIZE;
+    if (value > ((size_t)-1 >> shift))
+        return MEMORY_ERROR_MALFORMED_SIZE;
+    *bytes = (size_t)value << shift;
+    return 0;
+}
+
+int MemoryReport(FILE *f)
+{
+    int i;
+
+    if (fprintf(f, "[INFO] Memory accounted by module, in use / peak bytes:\n") < 0)
+        return MEMORY_ERROR_CANNOT_WRITE;
+    for (i = 0; i < MEMORY_CATEGORY_COUNT; i += 1)
+        if (fprintf(f, "\t%-14s %10lu / %10lu\n", _memoryCategoryNames[i], (unsigned long)_memoryInUse[i], (unsigned long)_memoryPeak[i]) < 0)
+            return MEMORY_ERROR_CANNOT_WRITE;
+    if (fprintf(f, "\t%-14s %10lu / %10lu\n", "Total", (unsigned long)_memoryTotal, (unsigned long)_memoryTotalPeak) < 0)
+        return MEMORY_ERROR_CANNOT_WRITE;
+    if (_memoryBudget != 0 && fprintf(f, "\t%-14s %10lu\n", "Budget", (unsigned long)_memoryBudget) < 0)
+        return MEMORY_ERROR_CANNOT_WRITE;
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef _MEMORY_H_LOADED
+#define _MEMORY_H_LOADED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+    Allocation accounting. Modules report the bytes they allocate and release under
+    a category; the bytes in use and the peak are kept per category and in total.
+    Nothing is allocated through this module, it only counts.
+
+    The optional budget is advisory: growable buffers ask MemoryFits() before
+    growing and fall back to something slower but bounded, such as a spill file.
+*/
+
+#define MEMORY_PARSER 0
+#define MEMORY_PREPROCESSOR 1
+#define MEMORY_SYMBOL_TABLE 2
+#define MEMORY_INSTRUCTION 3
+#define MEMORY_OUTPUT 4
+#define MEMORY_CPU 5
+#define MEMORY_CATEGORY_COUNT 6
+
+#define MEMORY_TOTAL -1
+
+void MemoryAllocated(int category, size_t bytes);
+void MemoryReleased(int category, size_t bytes);
+size_t MemoryInUse(int category);
+size_t MemoryPeak(int category);
+
+/* 0 for no budget */
+void MemorySetBudget(size_t bytes);
+size_t MemoryBudget(void);
+/* Whether allocating bytes more keeps the total within the budget. */
+int MemoryFits(size_t bytes);
+
+/* "SIZE", "SIZEk", "SIZEm" or "SIZEg" in bytes, KiB, MiB or GiB */
+int MemoryParseSize(const char *text, size_t *bytes);
+int MemoryReport(FILE *f);
+
+#define MEMORY_ERROR_MALFORMED_SIZE 1
+#define MEMORY_ERROR_CANNOT_WRITE 2
+
+#endif
@@ -0,0 +1,289 @@
+#include "object.h"
+#include "symboltable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _OBJECT_HEADER_COUNT 5
+
+static int _Object_build(InstructionStream_t *stream, Object_t *object, unsigned int *poolSize);
+static void _Object_release(Object_t *object);
+static int _Object_write(FILE *f, const Object_t *object, unsigned int poolSize);
+static int _Object_writeUInt32(FILE *f, unsigned int value);
+static int _Object_readUInt32(FILE *f, unsigned int *value);
+static int _Object_read(FILE *f, Object_t *object);
+static int _Object_readBody(FILE *f, Object_t *object, const unsigned int *header, unsigned int *offsets);
+
+int ObjectWrite(const char *filename, InstructionStream_t *stream)
+{
+    Object_t object;
+    unsigned int poolSize;
+    FILE *f;
+    int r;
+
+    memset(&object, 0, sizeof(object));
+    if ((r = _Object_build(stream, &object, &poolSize)) != 0)
+    {
+        _Object_release(&object);
+        return r;
+    }
+
+    if ((f = fopen(filename, "wb")) == NULL)
+        r = OBJECT_ERROR_CANNOT_OPEN;
+    else
+    {
+        r = _Object_write(f, &object, poolSize);
+        if (fclose(f) != 0 && r == 0)
+            r = OBJECT_ERROR_CANNOT_WRITE;
+    }
+    _Object_release(&object);
+    return r;
+}
+
+int ObjectRead(const char *filename, Object_t **object)
+{
+    Object_t *o;
+    FILE *f;
+    int r;
+
+    *object = NULL;
+    if ((o = (Object_t *)calloc(1, sizeof(*o))) == NULL)
+        return OBJECT_ERROR_NO_MEMORY;
+    if ((f = fopen(filename, "rb")) == NULL)
+    {
+        free(o);
+        return OBJECT_ERROR_CANNOT_OPEN;
+    }
+    r = _Object_read(f, o);
+    fclose(f);
+    if (r != 0)
+    {
+        ObjectFree(o);
+        return r;
+    }
+    *object = o;
+    return 0;
+}
+
+Object_t *ObjectFree(Object_t *object)
+{
+    if (object)
+    {
+        _Object_release(object);
+        free(object->pool);
+        free(object);
+    }
+    return NULL;
+}
+
+// ================================
+
+/* Labels and undefined symbols become object symbols, in ID order so that the
+   linker meets imports in first-use order. Builtins are resolved right here. */
+static int _Object_build(InstructionStream_t *stream, Object_t *object, unsigned int *poolSize)
+{
+    const Instruction_t *instruction;
+    unsigned int *symbolIndex;
+    unsigned int id, n, count;
+    int kind;
+
+    n = SymbolTableCount();
+    count = (unsigned int)InstructionStreamCount(stream);
+    symbolIndex = (unsigned int *)malloc((n ? n : 1) * sizeof(*symbolIndex));
+    object->symbols = (ObjectSymbol_t *)malloc((n ? n : 1) * sizeof(*object->symbols));
+    object->words = (unsigned short *)malloc((count ? count : 1) * sizeof(*object->words));
+    object->relocations = (ObjectRelocation_t *)malloc((count ? count : 1) * sizeof(*object->relocations));
+    if (symbolIndex == NULL || object->symbols == NULL || object->words == NULL || object->relocations == NULL)
+    {
+        free(symbolIndex);
+        return OBJECT_ERROR_NO_MEMORY;
+    }
+
+    *poolSize = 0;
+    for (id = 0; id < n; id += 1)
+    {
+        kind = SymbolTableKind((int)id);
+        if (kind != SYMBOL_KIND_LABEL && kind != SYMBOL_KIND_UNDEFINED)
+            continue;
+        symbolIndex[id] = object->symbolCount;
+        object->symbols[object->symbolCount].name = SymbolTableName((int)id);
+        object->symbols[object->symbolCount].kind = (kind == SYMBOL_KIND_LABEL) ? OBJECT_SYMBOL_LABEL : OBJECT_SYMBOL_IMPORT;
+        object->symbols[object->symbolCount].address = (kind == SYMBOL_KIND_LABEL) ? (unsigned int)SymbolTableAddress((int)id) : 0;
+        object->symbolCount += 1;
+        *poolSize += (unsigned int)strlen(SymbolTableName((int)id)) + 1;
+    }
+
+    if (InstructionStreamRewind(stream) != 0)
+    {
+        free(symbolIndex);
+        return OBJECT_ERROR_CANNOT_READ;
+    }
+    while ((instruction = InstructionStreamNext(stream)) != NULL)
+    {
+        switch (instruction->kind)
+        {
+        case INSTRUCTION_A_LITERAL:
+        case INSTRUCTION_C:
+            object->words[object->wordCount] = (unsigned short)instruction->operand;
+            break;
+        case INSTRUCTION_A_SYMBOL:
+            if (SymbolTableKind((int)instruction->operand) == SYMBOL_KIND_BUILTIN)
+                object->words[object->wordCount] = (unsigned short)SymbolTableAddress((int)instruction->operand);
+            else
+            {
+                object->words[object->wordCount] = 0;
+                object->relocations[object->relocationCount].word = object->wordCount;
+                object->relocations[object->relocationCount].symbol = symbolIndex[instruction->operand];
+                object->relocationCount += 1;
+            }
+            break;
+        default:
+            continue;
+        }
+        object->wordCount += 1;
+    }
+
+    free(symbolIndex);
+    return 0;
+}
+
+static void _Object_release(Object_t *object)
+{
+    free(object->words);
+    free(object->symbols);
+    free(object->relocations);
+    object->words = NULL;
+    object->symbols = NULL;
+    object->relocations = NULL;
+}
+
+static int _Object_write(FILE *f, const Object_t *object, unsigned int poolSize)
+{
+    unsigned char bytes[2];
+    unsigned int i, offset;
+    size_t length;
+
+    if (fwrite("HOBJ", 1, 4, f) != 4)
+        return OBJECT_ERROR_CANNOT_WRITE;
+    if (_Object_writeUInt32(f, OBJECT_VERSION) || _Object_writeUInt32(f, object->wordCount) || _Object_writeUInt32(f, object->symbolCount) || _Object_writeUInt32(f, object->relocationCount) || _Object_writeUInt32(f, poolSize))
+        return OBJECT_ERROR_CANNOT_WRITE;
+    for (i = 0; i < object->wordCount; i += 1)
+    {
+        bytes[0] = (unsigned char)(object->words[i] & 0xFF);
+        bytes[1] = (unsigned char)(object->words[i] >> 8);
+        if (fwrite(bytes, 1, 2, f) != 2)
+            return OBJECT_ERROR_CANNOT_WRITE;
+    }
+    for (i = 0, offset = 0; i < object->symbolCount; i += 1)
+    {
+        if (_Object_writeUInt32(f, offset) || _Object_writeUInt32(f, object->symbols[i].kind) || _Object_writeUInt32(f, object->symbols[i].address))
+            return OBJECT_ERROR_CANNOT_WRITE;
+        offset += (unsigned int)strlen(object->symbols[i].name) + 1;
+    }
+    for (i = 0; i < object->relocationCount; i += 1)
+        if (_Object_writeUInt32(f, object->relocations[i].word) || _Object_writeUInt32(f, object->relocations[i].symbol))
+            return OBJECT_ERROR_CANNOT_WRITE;
+    for (i = 0; i < object->symbolCount; i += 1)
+    {
+        length = strlen(object->symbols[i].name) + 1;
+        if (fwrite(object->symbols[i].name, 1, length, f) != length)
+            return OBJECT_ERROR_CANNOT_WRITE;
+    }
+    return 0;
+}
+
+static int _Object_writeUInt32(FILE *f, unsigned int value)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char)(value & 0xFF);
+    bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+    bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+    bytes[3] = (unsigned char)((value >> 24) & 0xFF);
+    return (fwrite(bytes, 1, 4, f) != 4) ? 1 : 0;
+}
+
+static int _Object_readUInt32(FILE *f, unsigned int *value)
+{
+    unsigned char bytes[4];
+
+    if (fread(bytes, 1, 4, f) != 4)
+        return 1;
+    *value = (unsigned int)bytes[0] | ((unsigned int)bytes[1] << 8) | ((unsigned int)bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+    return 0;
+}
+
+/* Every offset and index is checked, a damaged object never reaches the linker. */
+static int _Object_read(FILE *f, Object_t *object)
+{
+    unsigned int header[_OBJECT_HEADER_COUNT];
+    char magic[4];
+    unsigned int i, poolSize;
+    unsigned int *offsets;
+    int r;
+
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, "HOBJ", 4) != 0)
+        return OBJECT_ERROR_MALFORMED;
+    for (i = 0; i < _OBJECT_HEADER_COUNT; i += 1)
+        if (_Object_readUInt32(f, header + i))
+            return OBJECT_ERROR_CANNOT_READ;
+    if (header[0] != OBJECT_VERSION || header[1] > 0x10000 || header[3] > header[1])
+        return OBJECT_ERROR_MALFORMED;
+    poolSize = header[4];
+
+    object->words = (unsigned short *)malloc((header[1] ? header[1] : 1) * sizeof(*object->words));
+    object->symbols = (ObjectSymbol_t *)calloc(header[2] ? header[2] : 1, sizeof(*object->symbols));
+    object->relocations = (ObjectRelocation_t *)malloc((header[3] ? header[3] : 1) * sizeof(*object->relocations));
+    object->pool = (char *)malloc(poolSize ? poolSize : 1);
+    offsets = (unsigned int *)malloc((header[2] ? header[2] : 1) * sizeof(*offsets));
+    if (object->words == NULL || object->symbols == NULL || object->relocations == NULL || object->pool == NULL || offsets == NULL)
+    {
+        free(offsets);
+        return OBJECT_ERROR_NO_MEMORY;
+    }
+    r = _Object_readBody(f, object, header, offsets);
+    free(offsets);
+    return r;
+}
+
+static int _Object_readBody(FILE *f, Object_t *object, const unsigned int *header, unsigned int *offsets)
+{
+    unsigned char bytes[2];
+    unsigned int i, poolSize;
+
+    poolSize = header[4];
+
+    for (object->wordCount = 0; object->wordCount < header[1]; object->wordCount += 1)
+    {
+        if (fread(bytes, 1, 2, f) != 2)
+            return OBJECT_ERROR_CANNOT_READ;
+        object->words[object->wordCount] = (unsigned short)(bytes[0] | (bytes[1] << 8));
+    }
+    for (object->symbolCount = 0; object->symbolCount < header[2]; object->symbolCount += 1)
+    {
+        if (_Object_readUInt32(f, offsets + object->symbolCount) || _Object_readUInt32(f, &object->symbols[object->symbolCount].kind) || _Object_readUInt32(f, &object->symbols[object->symbolCount].address))
+            return OBJECT_ERROR_CANNOT_READ;
+        if (offsets[object->symbolCount] >= poolSize)
+            return OBJECT_ERROR_MALFORMED;
+        if (object->symbols[object->symbolCount].kind != OBJECT_SYMBOL_LABEL && object->symbols[object->symbolCount].kind != OBJECT_SYMBOL_IMPORT)
+            return OBJECT_ERROR_MALFORMED;
+        if (object->symbols[object->symbolCount].kind == OBJECT_SYMBOL_LABEL && object->symbols[object->symbolCount].address > object->wordCount)
+            return OBJECT_ERROR_MALFORMED;
+    }
+    for (object->relocationCount = 0; object->relocationCount < header[3]; object->relocationCount += 1)
+    {
+        if (_Object_readUInt32(f, &object->relocations[object->relocationCount].word) || _Object_readUInt32(f, &object->relocations[object->relocationCount].symbol))
+            return OBJECT_ERROR_CANNOT_READ;
+        if (object->relocations[object->relocationCount].word >= object->wordCount || object->relocations[object->relocationCount].symbol >= object->symbolCount)
+            return OBJECT_ERROR_MALFORMED;
+    }
+    if (fread(object->pool, 1, poolSize, f) != poolSize)
+        return OBJECT_ERROR_CANNOT_READ;
+    if (poolSize && object->pool[poolSize - 1] != '\0')
+        return OBJECT_ERROR_MALFORMED;
+
+    for (i = 0; i < object->symbolCount; i += 1)
+        object->symbols[i].name = object->pool + offsets[i];
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef _OBJECT_H_LOADED
+#define _OBJECT_H_LOADED
+
+#include "instruction.h"
+
+/*
+    Relocatable object file written by -c and read back by --link.
+
+    Format (little-endian):
+        magic "HOBJ", version, word count, symbol count, relocation count,
+            string pool size (32-bit unsigned integers),
+        words (16-bit), ROM addresses start from 0 in every object,
+        symbols { name offset, kind, address } (32-bit unsigned integers each),
+        relocations { word index, symbol index } (32-bit unsigned integers each),
+        string pool of NUL-terminated names.
+
+    Every label is written with its address inside the object and is local to it:
+    the words of the object that use it are relocated against the object's own base.
+    Every other symbol that is not a builtin is imported. A label is exported only
+    when another object imports its name, so each file may have its own LOOP or END;
+    an import that no object defines becomes a variable, and one that several
+    objects define is an error. A relocated word is replaced by the final address
+    of its symbol.
+*/
+
+#define OBJECT_VERSION 1
+
+#define OBJECT_SYMBOL_LABEL 1
+#define OBJECT_SYMBOL_IMPORT 2
+
+typedef struct
+{
+    const char *name;
+    unsigned int kind;
+    unsigned int address;
+} ObjectSymbol_t;
+
+typedef struct
+{
+    unsigned int word;
+    unsigned int symbol;
+} ObjectRelocation_t;
+
+typedef struct
+{
+    unsigned short *words;
+    unsigned int wordCount;
+    ObjectSymbol_t *symbols;
+    unsigned int symbolCount;
+    ObjectRelocation_t *relocations;
+    unsigned int relocationCount;
+    char *pool;
+} Object_t;
+
+/* Write the assembled stream, taking labels and imports from the symbol table. */
+int ObjectWrite(const char *filename, InstructionStream_t *stream);
+int ObjectRead(const char *filename, Object_t **object);
+Object_t *ObjectFree(Object_t *object);
+
+#define OBJECT_ERROR_CANNOT_OPEN 1
+#define OBJECT_ERROR_NO_MEMORY 2
+#define OBJECT_ERROR_CANNOT_WRITE 3
+#define OBJECT_ERROR_CANNOT_READ 4
+#define OBJECT_ERROR_MALFORMED 5
+
+#endif
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "memory.h"
+#include "preprocessor.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,7 +8,7 @@
 
 #define _COMMAND_MAX_LENGTH 256
 
-static FILE *_fileToParse = NULL;
+static int _parserOpened = 0;
 
 static char *currentCommand;
 static char *_symbol;
@@ -15,18 +17,23 @@ static char *_comp;
 static char *_jump;
 static size_t currentCommandLength;
 static int _lastCommandType;
+static int _lastLiteralKind;
+static int _lastLiteralValue;
+static int _literalMax = PARSER_LITERAL_MAX;
 
-static int _noNewLineCharAtEnd_ExpectEOF;
+static unsigned int _commandColumn;
+static unsigned int _skippedLines;
 
 static int _ParserAllocateMemory(void);
 static void _ParserFreeMemory(void);
 static void _ParserTruncateAfterInclusive(char *string, size_t *length, const char **stringsToTrucate, size_t count);
+static int _ParserClassifyLiteral(const char *string, int *value);
 
 int ParserInit(const char *filename)
 {
-    FILE *f;
+    int r;
 
-    if (_fileToParse)
+    if (_parserOpened)
         return PARSER_ERROR_ALREADY_OPENED;
     else
     {
@@ -34,19 +41,20 @@ int ParserInit(const char *filename)
             return PARSER_ERROR_NO_MEMORY;
         else
         {
-            f = fopen(filename, "r");
-            if (f)
+            r = PreprocessorOpen(filename);
+            if (r == 0)
             {
-                _fileToParse = f;
+                _parserOpened = 1;
                 memset(currentCommand, 0, _COMMAND_MAX_LENGTH);
                 _lastCommandType = 0;
-                _noNewLineCharAtEnd_ExpectEOF = 0;
+                _commandColumn = 0;
+                _skippedLines = 0;
                 return 0;
             }
             else
             {
-                free(currentCommand);
-                return PARSER_ERROR_CANNOT_OPEN;
+                _ParserFreeMemory();
+                return (r == PREPROCESSOR_ERROR_NO_MEMORY) ? PARSER_ERROR_NO_MEMORY : PARSER_ERROR_CANNOT_OPEN;
             }
         }
     }
@@ -54,14 +62,11 @@ int ParserInit(const char *filename)
 
 int ParserExit(void)
 {
-    FILE *f;
-
-    if (_fileToParse)
+    if (_parserOpened)
     {
-        f = _fileToParse;
-        _fileToParse = NULL;
+        _parserOpened = 0;
         _ParserFreeMemory();
-        return fclose(f);
+        return PreprocessorClose();
     }
     else
         return PARSER_ERROR_FILE_CLOSED;
@@ -69,8 +74,8 @@ int ParserExit(void)
 
 int hasMoreCommands(void)
 {
-    if (_fileToParse)
-        return (feof(_fileToParse) ? 0 : 1);
+    if (_parserOpened)
+        return (PreprocessorEof() ? 0 : 1);
     else
         return 0;
 }
@@ -83,47 +88,59 @@ int advance(void)
     static const char *commentString[] = {"#", "//"};
 
     char buffer[_COMMAND_MAX_LENGTH];
+    const char *p;
     size_t length;
+    int r;
 
-    int noNewLineChar = 0;
-
-    if (_fileToParse == NULL)
+    if (_parserOpened == 0)
         return PARSER_ERROR_FILE_CLOSED;
 
     _lastCommandType = 0;
-    if (fgets(buffer, sizeof(buffer), _fileToParse) == NULL)
-    {
-        if (feof(_fileToParse))
-            return PARSER_ERROR_EOF_REACHED;
-        else
-            return PARSER_ERROR_CANNOT_READ;
-    }
-    else
+    _lastLiteralKind = PARSER_LITERAL_NONE;
+    for (;;)
     {
-        length = strlen(buffer);
-        if (ParserRemoveAtEndOfLine(buffer, newLineChar, &length, sizeof(newLineChar)) == 0)
+        if ((r = PreprocessorReadLine(buffer, sizeof(buffer))) != 0)
         {
-            if (_noNewLineCharAtEnd_ExpectEOF == 0)
-                noNewLineChar = _noNewLineCharAtEnd_ExpectEOF = 1;
+            if (r == PREPROCESSOR_ERROR_EOF_REACHED)
+                return PARSER_ERROR_EOF_REACHED;
+            else if (r == PREPROCESSOR_ERROR_CANNOT_READ)
+                return PARSER_ERROR_CANNOT_READ;
             else
-                goto advance_line_too_long;
+                return PARSER_ERROR_PREPROCESSOR;
         }
-        _ParserTruncateAfterInclusive(buffer, &length, commentString, sizeof(commentString) / sizeof(commentString[0]));
-        ParserRemoveAtEndOfLine(buffer, spacingCharacters, &length, sizeof(spacingCharacters));
-        ParserRemoveAtStartOfLine(buffer, indentChar, &length, sizeof(indentChar));
-        memcpy(currentCommand, buffer, length + 1);
-        currentCommandLength = length;
-        if (length == 0)
-            return PARSER_ERROR_EMPTY_LINE;
-        else if (_noNewLineCharAtEnd_ExpectEOF && !noNewLineChar)
+        length = strlen(buffer);
+        // Only the last line of the file may end without a newline
+        if ((length == 0 || buffer[length - 1] != '\n') && !PreprocessorEof())
+        {
+            // Drop the rest of the line, parsing goes on from the next one
+            while (PreprocessorReadLine(buffer, sizeof(buffer)) == 0 && strchr(buffer, '\n') == NULL && !PreprocessorEof())
+                ;
             goto advance_line_too_long;
+        }
+        // Blank and comment-only lines are counted and dropped right here
+        for (p = buffer; *p == ' ' || *p == '\t'; p += 1)
+            ;
+        if (*p == '\n' || *p == '\0' || *p == '#' || (p[0] == '/' && p[1] == '/') || (p[0] == '\r' && (p[1] == '\n' || p[1] == '\0')))
+            _skippedLines += 1;
         else
-            return 0;
+            break;
     }
 
+    ParserRemoveAtEndOfLine(buffer, newLineChar, &length, sizeof(newLineChar));
+    _ParserTruncateAfterInclusive(buffer, &length, commentString, sizeof(commentString) / sizeof(commentString[0]));
+    ParserRemoveAtEndOfLine(buffer, spacingCharacters, &length, sizeof(spacingCharacters));
+    _commandColumn = (unsigned int)ParserRemoveAtStartOfLine(buffer, indentChar, &length, sizeof(indentChar)) + 1;
+    memcpy(currentCommand, buffer, length + 1);
+    currentCommandLength = length;
+    if (length == 0)
+        return PARSER_ERROR_EMPTY_LINE;
+    else
+        return 0;
+
 advance_line_too_long:
     *currentCommand = '\0';
     currentCommandLength = 0;
+    _commandColumn = 1;
     return PARSER_ERROR_LINE_TOO_LONG;
 }
 
@@ -132,7 +149,7 @@ int commandType(void)
     size_t length;
     char *p, *q;
 
-    if (_fileToParse == NULL)
+    if (_parserOpened == 0)
         return 0;
     if ((length = strlen(currentCommand)) == 0)
         return 0;
@@ -156,7 +173,7 @@ const char *symbol(void)
     size_t length;
     char *p, *q;
 
-    if (_fileToParse == NULL)
+    if (_parserOpened == 0)
         return NULL;
 
     switch (_lastCommandType)
@@ -180,9 +197,44 @@ const char *symbol(void)
     ParserRemoveAtBothSideOfLine(_symbol, spacingCharacters, &length, sizeof(spacingCharacters));
     if (length == 0)
         return NULL;
+    if (_lastCommandType == A_COMMAND)
+        _lastLiteralKind = _ParserClassifyLiteral(_symbol, &_lastLiteralValue);
     return _symbol;
 }
 
+int ParserSetLiteralMax(int max)
+{
+    int previous = _literalMax;
+
+    _literalMax = max;
+    return previous;
+}
+
+/* Line in the included file or macro body the current command came from. */
+unsigned int ParserLineNumber(void)
+{
+    return PreprocessorLineNumber();
+}
+
+/* Blank and comment-only lines advance() went past since ParserInit(). */
+unsigned int ParserSkippedLines(void)
+{
+    return _skippedLines;
+}
+
+/* Column of the first character of the current command, from 1. */
+unsigned int ParserColumn(void)
+{
+    return _commandColumn;
+}
+
+int literal(int *value)
+{
+    if (_lastLiteralKind == PARSER_LITERAL_DECIMAL)
+        *value = _lastLiteralValue;
+    return _lastLiteralKind;
+}
+
 const char *dest(void)
 {
     static const char spacingCharacters[] = {' '};
@@ -259,14 +311,15 @@ const char *jump(void)
 
 size_t ParserRemoveAtEndOfLine(char *string, const char *unwantedCharacters, size_t *stringLength, size_t characterLength)
 {
-    size_t i, j, k, l, m;
+    size_t j, k, l, m;
 
     k = *stringLength;
     m = characterLength;
-    for (i = k - 1, j = 0; j < k; i -= 1)
+    // Counts down from the end without an index that wraps below 0 on empty strings
+    for (j = 0; j < k;)
     {
         for (l = 0; l < m; l += 1)
-            if (string[i] == unwantedCharacters[l])
+            if (string[k - 1 - j] == unwantedCharacters[l])
                 break;
         if (l == m)
             break;
@@ -318,6 +371,7 @@ static int _ParserAllocateMemory(void)
     _dest = malloc(_COMMAND_MAX_LENGTH);
     _comp = malloc(_COMMAND_MAX_LENGTH);
     _jump = malloc(_COMMAND_MAX_LENGTH);
+    MemoryAllocated(MEMORY_PARSER, 5 * _COMMAND_MAX_LENGTH); // Released as a whole by _ParserFreeMemory
     if (!currentCommand || !_symbol || !_dest || !_comp || !_jump)
         goto _ParserAllocateMemory_failure;
     return 0;
@@ -329,6 +383,7 @@ _ParserAllocateMemory_failure:
 
 static void _ParserFreeMemory(void)
 {
+    MemoryReleased(MEMORY_PARSER, 5 * _COMMAND_MAX_LENGTH);
     free(currentCommand);
     free(_symbol);
     free(_dest);
@@ -351,3 +406,33 @@ static void _ParserTruncateAfterInclusive(char *string, size_t *length, const ch
         }
     }
 }
+
+static int _ParserClassifyLiteral(const char *string, int *value)
+{
+    const char *p = string;
+    int v = 0;
+    int kind = PARSER_LITERAL_DECIMAL;
+
+    if (*p == '-' || *p == '+')
+        p += 1;
+    if (*p < '0' || *p > '9')
+        return PARSER_LITERAL_NONE;
+    if (p != string)
+        return PARSER_LITERAL_MALFORMED;
+
+    for (; *p >= '0' && *p <= '9'; p += 1)
+    {
+        // Stop accumulating before going out of range so the value cannot overflow
+        if (kind != PARSER_LITERAL_DECIMAL)
+            continue;
+        if (v > (_literalMax - (*p - '0')) / 10)
+            kind = PARSER_LITERAL_OUT_OF_RANGE;
+        else
+            v = v * 10 + (*p - '0');
+    }
+    if (*p != '\0')
+        return PARSER_LITERAL_MALFORMED;
+
+    *value = v;
+    return kind;
+}
@@ -15,6 +15,18 @@ const char *symbol(void);
 const char *dest(void);
 const char *comp(void);
 const char *jump(void);
+int literal(int *value);
+int ParserSetLiteralMax(int max);
+unsigned int ParserLineNumber(void);
+unsigned int ParserColumn(void);
+unsigned int ParserSkippedLines(void);
+
+#define PARSER_LITERAL_NONE 0
+#define PARSER_LITERAL_DECIMAL 1
+#define PARSER_LITERAL_MALFORMED 2
+#define PARSER_LITERAL_OUT_OF_RANGE 3
+
+#define PARSER_LITERAL_MAX 32767 /* default upper bound */
 
 #define PARSER_ERROR_ALREADY_OPENED 1
 #define PARSER_ERROR_CANNOT_OPEN 2
@@ -22,8 +34,9 @@ const char *jump(void);
 #define PARSER_ERROR_EOF_REACHED 4
 #define PARSER_ERROR_CANNOT_READ 5
 #define PARSER_ERROR_NO_MEMORY 6
-#define PARSER_ERROR_EMPTY_LINE 7
+#define PARSER_ERROR_EMPTY_LINE 7 /* only for lines emptied by trimming, blank and comment lines are skipped */
 #define PARSER_ERROR_LINE_TOO_LONG 8
+#define PARSER_ERROR_PREPROCESSOR 9 /* details from PreprocessorLastError() */
 
 #include <string.h>
 size_t ParserRemoveAtEndOfLine(char *string, const char *unwantedCharacters, size_t *stringLength, size_t characterLength);
@@ -0,0 +1,127 @@
+#include "peephole.h"
+#include "code.h"
+
+#include <string.h>
+
+#define _PEEPHOLE_WINDOW 64
+
+#define _PEEPHOLE_DEST(word) (((word) >> 3) & 7u)
+#define _PEEPHOLE_COMP(word) (((word) >> 6) & 0x7Fu)
+#define _PEEPHOLE_JUMP(word) ((word)&7u)
+
+typedef struct
+{
+    Instruction_t pending[_PEEPHOLE_WINDOW];
+    unsigned int count;
+    unsigned int removed;
+    unsigned int compD, compA, destD, destA;
+    InstructionStream_t *output;
+} PeepholeState_t;
+
+static int _PeepholeIsNoOp(const PeepholeState_t *state, unsigned int word);
+static int _PeepholeLastInstruction(const PeepholeState_t *state);
+static void _PeepholeRemove(PeepholeState_t *state, int index);
+static int _PeepholeFlush(PeepholeState_t *state, unsigned int count);
+
+int PeepholeOptimize(InstructionStream_t *input, InstructionStream_t *output, unsigned int *removed)
+{
+    PeepholeState_t state;
+    const Instruction_t *instruction;
+    int last;
+
+    state.count = 0;
+    state.removed = 0;
+    state.output = output;
+    state.compD = Code_bitString2int(Code_comp("D"));
+    state.compA = Code_bitString2int(Code_comp("A"));
+    state.destD = Code_bitString2int(Code_dest("D"));
+    state.destA = Code_bitString2int(Code_dest("A"));
+
+    if (InstructionStreamRewind(input) != 0)
+        return PEEPHOLE_ERROR_CANNOT_READ;
+    while ((instruction = InstructionStreamNext(input)) != NULL)
+    {
+        last = _PeepholeLastInstruction(&state);
+        switch (instruction->kind)
+        {
+        case INSTRUCTION_C:
+            if (_PeepholeIsNoOp(&state, instruction->operand))
+            {
+                state.removed += 1;
+                continue;
+            }
+            break;
+        case INSTRUCTION_A_LITERAL:
+        case INSTRUCTION_A_SYMBOL:
+            // Labels in between do not matter: the overwritten value is dead on every path
+            if (last >= 0 && state.pending[last].kind != INSTRUCTION_C)
+                _PeepholeRemove(&state, last);
+            break;
+        case INSTRUCTION_LABEL:
+            // @L immediately followed by a store-less jump, falling through to (L)
+            if (last >= 1 && state.pending[last].kind == INSTRUCTION_C && state.pending[last - 1].kind == INSTRUCTION_A_SYMBOL && state.pending[last - 1].operand == instruction->operand && _PEEPHOLE_DEST(state.pending[last].operand) == 0 && _PEEPHOLE_JUMP(state.pending[last].operand) != 0)
+                _PeepholeRemove(&state, last);
+            break;
+        }
+
+        if (state.count == _PEEPHOLE_WINDOW && _PeepholeFlush(&state, 1) != 0)
+            return PEEPHOLE_ERROR_NO_MEMORY;
+        state.pending[state.count++] = *instruction;
+    }
+
+    if (_PeepholeFlush(&state, state.count) != 0)
+        return PEEPHOLE_ERROR_NO_MEMORY;
+    if (removed)
+        *removed = state.removed;
+    return 0;
+}
+
+// ================================
+
+static int _PeepholeIsNoOp(const PeepholeState_t *state, unsigned int word)
+{
+    unsigned int destBits = _PEEPHOLE_DEST(word);
+
+    if (_PEEPHOLE_JUMP(word) != 0)
+        return 0;
+    if (destBits == 0)
+        return 1;
+    if (destBits == state->destD && _PEEPHOLE_COMP(word) == state->compD)
+        return 1;
+    if (destBits == state->destA && _PEEPHOLE_COMP(word) == state->compA)
+        return 1;
+    return 0;
+}
+
+static int _PeepholeLastInstruction(const PeepholeState_t *state)
+{
+    int i;
+
+    for (i = (int)state->count - 1; i >= 0; i -= 1)
+        if (state->pending[i].kind != INSTRUCTION_LABEL)
+            break;
+    return i;
+}
+
+static void _PeepholeRemove(PeepholeState_t *state, int index)
+{
+    memmove(state->pending + index, state->pending + index + 1, (state->count - (unsigned int)index - 1) * sizeof(state->pending[0]));
+    state->count -= 1;
+    state->removed += 1;
+}
+
+static int _PeepholeFlush(PeepholeState_t *state, unsigned int count)
+{
+    unsigned int i;
+    const Instruction_t *instruction;
+
+    for (i = 0; i < count; i += 1)
+    {
+        instruction = state->pending + i;
+        if (InstructionStreamAppend(state->output, instruction->kind, instruction->operand, instruction->line) != 0)
+            return PEEPHOLE_ERROR_NO_MEMORY;
+    }
+    memmove(state->pending, state->pending + count, (state->count - count) * sizeof(state->pending[0]));
+    state->count -= count;
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef _PEEPHOLE_H_LOADED
+#define _PEEPHOLE_H_LOADED
+
+#include "instruction.h"
+
+/*
+    Copy an instruction stream, leaving out instructions that cannot change the program state:
+        - an A-instruction directly overwritten by the next A-instruction,
+        - a C-instruction that neither stores nor jumps, or stores D into D or A into A,
+        - a store-less jump @L / comp;jump whose target L is the very next instruction.
+    Labels are kept; their addresses have to be recomputed from the output stream.
+*/
+int PeepholeOptimize(InstructionStream_t *input, InstructionStream_t *output, unsigned int *removed);
+
+#define PEEPHOLE_ERROR_NO_MEMORY 1
+#define PEEPHOLE_ERROR_CANNOT_READ 2
+
+#endif
@@ -0,0 +1,295 @@
+#include "pipeline.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char data[PIPELINE_BLOCK_SIZE];
+    size_t length;
+    int full; // Owned by the consumer of the block while set
+} PipelineBlock_t;
+
+struct PipelineReader
+{
+    PipelineBlock_t blocks[2];
+    FILE *file;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int current;  // Block the caller reads from
+    int held;     // The caller holds the current block
+    size_t position;
+    int done;     // The thread has read the last block
+    int eof;      // The caller ran into the end, like feof()
+    int error;
+    int stop;
+};
+
+struct PipelineWriter
+{
+    PipelineBlock_t blocks[2];
+    FILE *output;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int current; // Block the caller fills
+    int error;
+    int stop;
+};
+
+static void *_PipelineReaderThread(void *param);
+static int _PipelineReaderFill(PipelineReader_t *reader);
+static void *_PipelineWriterThread(void *param);
+static int _PipelineWriterHandOver(PipelineWriter_t *writer);
+
+PipelineReader_t *PipelineReaderOpen(FILE *input)
+{
+    PipelineReader_t *reader;
+
+    if ((reader = (PipelineReader_t *)calloc(1, sizeof(*reader))) == NULL)
+        return NULL;
+    reader->file = input;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+    if (pthread_create(&reader->thread, NULL, _PipelineReaderThread, reader) != 0)
+    {
+        pthread_cond_destroy(&reader->changed);
+        pthread_mutex_destroy(&reader->lock);
+        free(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+/* Up to size - 1 characters, stopping after a '\n'. A line may span both blocks. */
+int PipelineReaderGets(PipelineReader_t *reader, char *buffer, int size)
+{
+    const PipelineBlock_t *block;
+    const char *data, *end;
+    size_t used, n;
+    int r;
+
+    used = 0;
+    while (used + 1 < (size_t)size)
+    {
+        if ((r = _PipelineReaderFill(reader)) != 0)
+        {
+            reader->eof = (r == PIPELINE_ERROR_EOF_REACHED);
+            if (reader->eof && used)
+                break;
+            return r;
+        }
+        block = reader->blocks + reader->current;
+        data = block->data + reader->position;
+        n = block->length - reader->position;
+        if (n > (size_t)size - 1 - used)
+            n = (size_t)size - 1 - used;
+        if ((end = (const char *)memchr(data, '\n', n)) != NULL)
+            n = (size_t)(end - data) + 1;
+        memcpy(buffer + used, data, n);
+        used += n;
+        reader->position += n;
+        if (end)
+            break;
+    }
+    buffer[used] = '\0';
+    return 0;
+}
+
+int PipelineReaderEof(const PipelineReader_t *reader)
+{
+    return reader->eof;
+}
+
+int PipelineReaderClose(PipelineReader_t *reader)
+{
+    int r;
+
+    if (reader == NULL)
+        return 0;
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = 1;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+    pthread_cond_destroy(&reader->changed);
+    pthread_mutex_destroy(&reader->lock);
+    r = fclose(reader->file);
+    free(reader);
+    return r;
+}
+
+PipelineWriter_t *PipelineWriterOpen(FILE *output)
+{
+    PipelineWriter_t *writer;
+
+    if ((writer = (PipelineWriter_t *)calloc(1, sizeof(*writer))) == NULL)
+        return NULL;
+    writer->output = output;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    if (pthread_create(&writer->thread, NULL, _PipelineWriterThread, writer) != 0)
+    {
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int PipelineWriterWrite(PipelineWriter_t *writer, const void *data, size_t length)
+{
+    PipelineBlock_t *block;
+    size_t n;
+
+    while (length)
+    {
+        block = writer->blocks + writer->current;
+        n = PIPELINE_BLOCK_SIZE - block->length;
+        if (n > length)
+            n = length;
+        memcpy(block->data + block->length, data, n);
+        block->length += n;
+        data = (const char *)data + n;
+        length -= n;
+        if (block->length == PIPELINE_BLOCK_SIZE && _PipelineWriterHandOver(writer) != 0)
+            return PIPELINE_ERROR_CANNOT_WRITE;
+    }
+    return 0;
+}
+
+int PipelineWriterClose(PipelineWriter_t *writer)
+{
+    int r;
+
+    if (writer == NULL)
+        return 0;
+    r = (writer->blocks[writer->current].length) ? _PipelineWriterHandOver(writer) : 0;
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+    if (writer->error || fflush(writer->output) != 0)
+        r = PIPELINE_ERROR_CANNOT_WRITE;
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer);
+    return r;
+}
+
+// ================================
+
+/* Fills the blocks in turn, waiting while both are full; stops after a short read. */
+static void *_PipelineReaderThread(void *param)
+{
+    PipelineReader_t *reader = (PipelineReader_t *)param;
+    PipelineBlock_t *block;
+    size_t n;
+    int next, stop;
+
+    for (next = 0;; next ^= 1)
+    {
+        block = reader->blocks + next;
+        pthread_mutex_lock(&reader->lock);
+        while (!reader->stop && block->full)
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        stop = reader->stop;
+        pthread_mutex_unlock(&reader->lock);
+        if (stop)
+            break;
+
+        n = fread(block->data, 1, PIPELINE_BLOCK_SIZE, reader->file);
+        pthread_mutex_lock(&reader->lock);
+        block->length = n;
+        block->full = 1;
+        if (n < PIPELINE_BLOCK_SIZE)
+        {
+            reader->done = 1;
+            reader->error = ferror(reader->file);
+        }
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+        if (n < PIPELINE_BLOCK_SIZE)
+            break;
+    }
+    return NULL;
+}
+
+/* Makes sure the current block has unread data, handing the used one back to the thread. */
+static int _PipelineReaderFill(PipelineReader_t *reader)
+{
+    PipelineBlock_t *block = reader->blocks + reader->current;
+
+    if (reader->held && reader->position < block->length)
+        return 0;
+
+    pthread_mutex_lock(&reader->lock);
+    if (reader->held)
+    {
+        block->full = 0;
+        reader->held = 0;
+        reader->current ^= 1;
+        block = reader->blocks + reader->current;
+        pthread_cond_broadcast(&reader->changed);
+    }
+    while (!block->full && !reader->done)
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    pthread_mutex_unlock(&reader->lock);
+
+    if (!block->full || block->length == 0)
+        return reader->error ? PIPELINE_ERROR_CANNOT_READ : PIPELINE_ERROR_EOF_REACHED;
+    reader->held = 1;
+    reader->position = 0;
+    return 0;
+}
+
+/* Writes the blocks in turn as they are handed over, until told to stop with none pending. */
+static void *_PipelineWriterThread(void *param)
+{
+    PipelineWriter_t *writer = (PipelineWriter_t *)param;
+    PipelineBlock_t *block;
+    int next, full, error;
+
+    for (next = 0;; next ^= 1)
+    {
+        block = writer->blocks + next;
+        pthread_mutex_lock(&writer->lock);
+        while (!writer->stop && !block->full)
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        full = block->full;
+        pthread_mutex_unlock(&writer->lock);
+        if (!full)
+            break;
+
+        error = (fwrite(block->data, 1, block->length, writer->output) != block->length);
+        pthread_mutex_lock(&writer->lock);
+        writer->error |= error;
+        block->length = 0;
+        block->full = 0;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+    }
+    return NULL;
+}
+
+/* Passes the current block to the thread and waits until the other one is free. */
+static int _PipelineWriterHandOver(PipelineWriter_t *writer)
+{
+    PipelineBlock_t *block;
+    int error;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->blocks[writer->current].full = 1;
+    writer->current ^= 1;
+    block = writer->blocks + writer->current;
+    pthread_cond_broadcast(&writer->changed);
+    while (block->full)
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+    return error ? PIPELINE_ERROR_CANNOT_WRITE : 0;
+}
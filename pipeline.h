@@ -0,0 +1,43 @@
+#ifndef _PIPELINE_H_LOADED
+#define _PIPELINE_H_LOADED
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+    Double-buffered file I/O on a helper thread, so that the assembler encodes while
+    the storage is busy.
+
+    Reader: a thread reads the file ahead in PIPELINE_BLOCK_SIZE blocks, filling one
+    block while the caller takes lines out of the other. PipelineReaderGets() has the
+    contract of fgets().
+
+    Writer: the caller copies text into one block while a thread writes the other
+    one out with fwrite(). Close hands over what is left, waits for the thread and
+    flushes the FILE, which stays open.
+
+    Each side keeps PIPELINE_BUFFER_BYTES in its blocks.
+*/
+
+#define PIPELINE_BLOCK_SIZE 65536
+#define PIPELINE_BUFFER_BYTES (2 * PIPELINE_BLOCK_SIZE)
+
+typedef struct PipelineReader PipelineReader_t;
+typedef struct PipelineWriter PipelineWriter_t;
+
+/* NULL if the thread cannot start, the caller keeps input then. Otherwise the reader
+   owns input and Close closes it. */
+PipelineReader_t *PipelineReaderOpen(FILE *input);
+int PipelineReaderGets(PipelineReader_t *reader, char *buffer, int size);
+int PipelineReaderEof(const PipelineReader_t *reader);
+int PipelineReaderClose(PipelineReader_t *reader);
+
+PipelineWriter_t *PipelineWriterOpen(FILE *output);
+int PipelineWriterWrite(PipelineWriter_t *writer, const void *data, size_t length);
+int PipelineWriterClose(PipelineWriter_t *writer);
+
+#define PIPELINE_ERROR_EOF_REACHED 1
+#define PIPELINE_ERROR_CANNOT_READ 2
+#define PIPELINE_ERROR_CANNOT_WRITE 3
+
+#endif
@@ -0,0 +1,844 @@
+#include "preprocessor.h"
+#include "avl_tree.h"
+#include "memory.h"
+#include "pipeline.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define _PREPROCESSOR_MAX_DEPTH 16
+#define _PREPROCESSOR_MAX_PARAMETERS 8
+#define _PREPROCESSOR_LINE_LENGTH 256
+#define _PREPROCESSOR_PATH_LENGTH 1024
+
+// Returned by the directive handlers when the line must not reach the parser
+#define _PREPROCESSOR_CONSUMED -1
+
+typedef struct
+{
+    char *path;
+    char *data;
+    size_t length;
+    time_t mtime;
+    off_t size;
+    unsigned int generation; // Top-level file that included it last
+} PreprocessorInclude_t;
+
+typedef struct
+{
+    char *name;
+    char *parameters[_PREPROCESSOR_MAX_PARAMETERS];
+    int parameterCount;
+    char *body;
+    size_t length;
+    size_t capacity;
+} PreprocessorMacro_t;
+
+// Lines read in a row from one source, from position on
+typedef struct
+{
+    unsigned int position;
+    unsigned int name; // Index into _spanNames
+    unsigned int line;
+} PreprocessorSpan_t;
+
+typedef struct
+{
+    FILE *file;       // Top-level file only
+    PipelineReader_t *reader; // Top-level file read ahead, instead of file
+    const char *name; // For error messages
+    const char *path; // NULL for macro expansions
+    const char *data;
+    size_t length;
+    size_t position;
+    unsigned int line;
+    int continued; // Last piece read did not end the line
+    const PreprocessorMacro_t *macro;
+    char *arguments[_PREPROCESSOR_MAX_PARAMETERS];
+    char *argumentStorage;
+} PreprocessorSource_t;
+
+static PreprocessorSource_t _sources[_PREPROCESSOR_MAX_DEPTH];
+static int _depth = 0;
+static int _eof;
+static unsigned int _generation = 0;
+static int _readAhead = 0;
+static char *_topLevelPath = NULL;
+static AVL_TREE *_includeCache = NULL;
+static AVL_TREE *_macros = NULL;
+static PreprocessorMacro_t *_definingMacro = NULL;
+static int _definingDepth;
+
+// Where every line read since the last open came from, kept after close for pass 2
+static PreprocessorSpan_t *_spans = NULL;
+static size_t _spanCount = 0;
+static size_t _spanCapacity = 0;
+static size_t _spanFound = 0;
+static char **_spanNames = NULL;
+static unsigned int _spanNameCount = 0;
+static unsigned int _position = 0;
+static unsigned int _pushes = 0; // Sources pushed and popped, a new span starts after any
+static unsigned int _spanPushes = 0;
+
+static char _errorSource[_PREPROCESSOR_PATH_LENGTH];
+static unsigned int _errorLine;
+static int _errorCode;
+static char _errorSubject[_PREPROCESSOR_PATH_LENGTH];
+
+AVL_DEFINE_STRING_RETRIEVE(_Preprocessor_retrieveInclude, PreprocessorInclude_t, path)
+AVL_DEFINE_STRING_RETRIEVE(_Preprocessor_retrieveMacro, PreprocessorMacro_t, name)
+
+static int _Preprocessor_cmp_PreprocessorInclude(void *a, void *b);
+static void _Preprocessor_free_PreprocessorInclude(void *p);
+static int _Preprocessor_cmp_PreprocessorMacro(void *a, void *b);
+static void _Preprocessor_free_PreprocessorMacro(void *p);
+
+static int _PreprocessorReadBuffer(PreprocessorSource_t *source, char *buffer, int size);
+static void _PreprocessorSubstitute(const PreprocessorSource_t *source, const char *line, char *buffer, int size);
+static int _PreprocessorDirective(PreprocessorSource_t *source, char *line);
+static int _PreprocessorDefineLine(PreprocessorSource_t *source, const char *line, int continued);
+static int _PreprocessorInclude(PreprocessorSource_t *source, char *rest);
+static int _PreprocessorBeginMacro(PreprocessorSource_t *source, char *rest);
+static int _PreprocessorExpand(PreprocessorSource_t *source, const PreprocessorMacro_t *macro, char *rest);
+static int _PreprocessorLoad(const char *path, PreprocessorInclude_t **include);
+static int _PreprocessorResolve(char *path, size_t size, const char *name);
+static void _PreprocessorPop(void);
+static int _PreprocessorCountLine(const PreprocessorSource_t *source);
+static int _PreprocessorSpanName(const char *name, unsigned int *index);
+static void _PreprocessorClearSpans(void);
+static int _PreprocessorError(const PreprocessorSource_t *source, int code, const char *subject);
+static const char *_PreprocessorWord(const char *line, size_t *length);
+static int _PreprocessorIsWord(const char *word, size_t length, const char *keyword);
+static size_t _PreprocessorIdentifierLength(const char *string);
+static char *_PreprocessorTrim(char *string);
+static char *_PreprocessorCopy(const char *string, size_t length);
+
+int PreprocessorOpen(const char *filename)
+{
+    PipelineReader_t *reader = NULL;
+    FILE *f;
+
+    if (_depth)
+        return PREPROCESSOR_ERROR_ALREADY_OPENED;
+    if (_includeCache == NULL && (_includeCache = AVL_Create(_Preprocessor_cmp_PreprocessorInclude, _Preprocessor_free_PreprocessorInclude)) == NULL)
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    if ((_macros = AVL_Create(_Preprocessor_cmp_PreprocessorMacro, _Preprocessor_free_PreprocessorMacro)) == NULL)
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    if ((_topLevelPath = strdup(filename)) == NULL)
+    {
+        _macros = AVL_Destroy(_macros);
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    }
+    if ((f = fopen(filename, "r")) == NULL)
+    {
+        free(_topLevelPath);
+        _topLevelPath = NULL;
+        _macros = AVL_Destroy(_macros);
+        return PREPROCESSOR_ERROR_CANNOT_OPEN;
+    }
+
+    // Reads on the calling thread when the reader cannot start
+    memset(&_sources[0], 0, sizeof(_sources[0]));
+    if (_readAhead && (reader = PipelineReaderOpen(f)) != NULL)
+    {
+        MemoryAllocated(MEMORY_PREPROCESSOR, PIPELINE_BUFFER_BYTES);
+        f = NULL;
+    }
+    _sources[0].file = f;
+    _sources[0].reader = reader;
+    _sources[0].name = _sources[0].path = _topLevelPath;
+    _depth = 1;
+    _PreprocessorClearSpans();
+    _eof = 0;
+    _generation += 1;
+    _definingMacro = NULL;
+    *_errorSource = '\0';
+    *_errorSubject = '\0';
+    _errorLine = 0;
+    _errorCode = 0;
+    return 0;
+}
+
+int PreprocessorClose(void)
+{
+    int r;
+
+    if (_depth == 0)
+        return PREPROCESSOR_ERROR_FILE_CLOSED;
+
+    while (_depth > 1)
+        _PreprocessorPop();
+    if (_sources[0].reader)
+    {
+        r = PipelineReaderClose(_sources[0].reader);
+        MemoryReleased(MEMORY_PREPROCESSOR, PIPELINE_BUFFER_BYTES);
+    }
+    else
+        r = fclose(_sources[0].file);
+    _depth = 0;
+    if (_definingMacro)
+    {
+        _Preprocessor_free_PreprocessorMacro(_definingMacro);
+        _definingMacro = NULL;
+    }
+    _macros = AVL_Destroy(_macros);
+    free(_topLevelPath);
+    _topLevelPath = NULL;
+    return r;
+}
+
+void PreprocessorSetReadAhead(int enabled)
+{
+    _readAhead = enabled;
+}
+
+/* Same contract as fgets() on the top-level file, with directives already applied. */
+int PreprocessorReadLine(char *buffer, int size)
+{
+    char line[_PREPROCESSOR_LINE_LENGTH];
+    PreprocessorSource_t *source;
+    int r, continued;
+
+    if (_depth == 0)
+        return PREPROCESSOR_ERROR_FILE_CLOSED;
+
+    for (;;)
+    {
+        source = &_sources[_depth - 1];
+        if (source->reader)
+        {
+            if ((r = PipelineReaderGets(source->reader, buffer, size)) != 0)
+                r = (r == PIPELINE_ERROR_EOF_REACHED) ? PREPROCESSOR_ERROR_EOF_REACHED : PREPROCESSOR_ERROR_CANNOT_READ;
+        }
+        else if (source->file)
+        {
+            if (fgets(buffer, size, source->file) == NULL)
+                r = feof(source->file) ? PREPROCESSOR_ERROR_EOF_REACHED : PREPROCESSOR_ERROR_CANNOT_READ;
+            else
+                r = 0;
+        }
+        else if (source->macro)
+        {
+            if ((r = _PreprocessorReadBuffer(source, line, sizeof(line))) == 0)
+                _PreprocessorSubstitute(source, line, buffer, size);
+        }
+        else
+            r = _PreprocessorReadBuffer(source, buffer, size);
+
+        if (r == PREPROCESSOR_ERROR_EOF_REACHED)
+        {
+            if (_definingMacro && _definingDepth == _depth)
+                return _PreprocessorError(source, PREPROCESSOR_ERROR_UNTERMINATED_MACRO, _definingMacro->name);
+            if (_depth == 1)
+            {
+                _eof = 1;
+                return r;
+            }
+            _PreprocessorPop();
+            continue;
+        }
+        else if (r != 0)
+            return r;
+
+        // The rest of an overlong line is neither a new line nor a directive
+        continued = source->continued;
+        source->continued = (strchr(source->macro ? line : buffer, '\n') == NULL);
+        if (!continued)
+        {
+            source->line += 1;
+            if ((r = _PreprocessorCountLine(source)) != 0)
+                return r;
+        }
+        if (_definingMacro)
+            r = _PreprocessorDefineLine(source, buffer, continued);
+        else if (continued)
+            r = 0;
+        else
+            r = _PreprocessorDirective(source, buffer);
+        if (r == _PREPROCESSOR_CONSUMED)
+            continue;
+        else if (r != 0)
+            return r;
+
+        if (_depth == 1 && (source->reader ? PipelineReaderEof(source->reader) : feof(source->file)))
+            _eof = 1;
+        return 0;
+    }
+}
+
+int PreprocessorEof(void)
+{
+    return _depth == 0 || _eof;
+}
+
+/* Line of the last line read, in the included file or macro body it came from. */
+unsigned int PreprocessorLineNumber(void)
+{
+    return _depth ? _sources[_depth - 1].line : 0;
+}
+
+/* Path of the file, or name of the macro, the last line was read from. */
+const char *PreprocessorSourceName(void)
+{
+    return _depth ? _sources[_depth - 1].name : NULL;
+}
+
+/* Position of the last line read, counting the lines of every source since the open. */
+unsigned int PreprocessorPosition(void)
+{
+    return _position;
+}
+
+/* Source and line of a position, valid until the next open. */
+int PreprocessorLocate(unsigned int position, const char **source, unsigned int *line)
+{
+    size_t low, high, middle;
+
+    if (_spanCount == 0 || position < _spans[0].position)
+        return PREPROCESSOR_ERROR_FILE_CLOSED;
+    // Pass 2 asks in order, try the span of the last answer and the one after it first
+    if (_spanFound >= _spanCount || position < _spans[_spanFound].position)
+        _spanFound = 0;
+    if (_spanFound + 1 < _spanCount && position >= _spans[_spanFound + 1].position)
+        _spanFound += 1;
+    if (_spanFound + 1 < _spanCount && position >= _spans[_spanFound + 1].position)
+    {
+        low = _spanFound + 1;
+        high = _spanCount;
+        while (high - low > 1)
+        {
+            middle = low + (high - low) / 2;
+            if (_spans[middle].position <= position)
+                low = middle;
+            else
+                high = middle;
+        }
+        _spanFound = low;
+    }
+    *source = _spanNames[_spans[_spanFound].name];
+    *line = _spans[_spanFound].line + (position - _spans[_spanFound].position);
+    return 0;
+}
+
+/* Code and place of the last directive that failed. */
+int PreprocessorLastError(const char **source, unsigned int *line, const char **subject)
+{
+    *source = _errorSource;
+    *line = _errorLine;
+    *subject = _errorSubject;
+    return _errorCode;
+}
+
+void PreprocessorClearCache(void)
+{
+    if (_includeCache)
+        _includeCache = AVL_Destroy(_includeCache);
+    _PreprocessorClearSpans();
+    MemoryReleased(MEMORY_PREPROCESSOR, _spanCapacity * sizeof(*_spans));
+    free(_spans);
+    _spans = NULL;
+    _spanCapacity = 0;
+}
+
+// ================================
+
+static int _Preprocessor_cmp_PreprocessorInclude(void *a, void *b)
+{
+    return strcmp(((PreprocessorInclude_t *)a)->path, ((PreprocessorInclude_t *)b)->path);
+}
+
+static void _Preprocessor_free_PreprocessorInclude(void *p)
+{
+    PreprocessorInclude_t *include = (PreprocessorInclude_t *)p;
+
+    if (include->data != NULL)
+        MemoryReleased(MEMORY_PREPROCESSOR, include->length + 1);
+    free(include->path);
+    free(include->data);
+    free(include);
+}
+
+static int _Preprocessor_cmp_PreprocessorMacro(void *a, void *b)
+{
+    return strcmp(((PreprocessorMacro_t *)a)->name, ((PreprocessorMacro_t *)b)->name);
+}
+
+static void _Preprocessor_free_PreprocessorMacro(void *p)
+{
+    PreprocessorMacro_t *macro = (PreprocessorMacro_t *)p;
+    int i;
+
+    for (i = 0; i < macro->parameterCount; i += 1)
+        free(macro->parameters[i]);
+    MemoryReleased(MEMORY_PREPROCESSOR, macro->capacity);
+    free(macro->name);
+    free(macro->body);
+    free(macro);
+}
+
+// ================================
+
+/* fgets() over an in-memory source. A last line without '\n' gets one, so only
+   the top-level file can end without a newline. */
+static int _PreprocessorReadBuffer(PreprocessorSource_t *source, char *buffer, int size)
+{
+    const char *p, *end;
+    size_t n;
+
+    if (source->position >= source->length)
+        return PREPROCESSOR_ERROR_EOF_REACHED;
+
+    p = source->data + source->position;
+    end = (const char *)memchr(p, '\n', source->length - source->position);
+    n = end ? (size_t)(end - p) : source->length - source->position;
+    if (n + 2 > (size_t)size)
+    {
+        // Too long, hand it out in pieces like fgets() does
+        n = (size_t)size - 1;
+        memcpy(buffer, p, n);
+        buffer[n] = '\0';
+        source->position += n;
+        return 0;
+    }
+    memcpy(buffer, p, n);
+    buffer[n] = '\n';
+    buffer[n + 1] = '\0';
+    source->position += n + (end ? 1 : 0);
+    return 0;
+}
+
+/* Copy a macro body line, replacing {parameter} with the argument. A line that
+   grows past the buffer loses its newline, which the parser reports as too long. */
+static void _PreprocessorSubstitute(const PreprocessorSource_t *source, const char *line, char *buffer, int size)
+{
+    const char *text, *close;
+    size_t used, length;
+    int i;
+
+    used = 0;
+    while (*line && used + 1 < (size_t)size)
+    {
+        text = line;
+        length = 1;
+        if (*line == '{' && (close = strchr(line + 1, '}')) != NULL)
+        {
+            for (i = 0; i < source->macro->parameterCount; i += 1)
+                if (_PreprocessorIsWord(line + 1, (size_t)(close - line - 1), source->macro->parameters[i]))
+                {
+                    text = source->arguments[i];
+                    length = strlen(text);
+                    line = close;
+                    break;
+                }
+        }
+        if (length > (size_t)size - 1 - used)
+            length = (size_t)size - 1 - used;
+        memcpy(buffer + used, text, length);
+        used += length;
+        line += 1;
+    }
+    buffer[used] = '\0';
+}
+
+static int _PreprocessorDirective(PreprocessorSource_t *source, char *line)
+{
+    char name[_PREPROCESSOR_LINE_LENGTH];
+    const PreprocessorMacro_t *macro;
+    const char *word;
+    size_t length;
+
+    if ((word = _PreprocessorWord(line, &length)) == NULL)
+        return 0;
+
+    if (_PreprocessorIsWord(word, length, "include"))
+        return _PreprocessorInclude(source, (char *)word + length);
+    else if (_PreprocessorIsWord(word, length, "macro"))
+        return _PreprocessorBeginMacro(source, (char *)word + length);
+    else if (_PreprocessorIsWord(word, length, "endmacro"))
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_STRAY_ENDMACRO, "endmacro");
+
+    memcpy(name, word, length);
+    name[length] = '\0';
+    if ((macro = (const PreprocessorMacro_t *)_Preprocessor_retrieveMacro(_macros, name)) == NULL)
+        return 0; // Not ours, the parser drops it as a comment
+    return _PreprocessorExpand(source, macro, (char *)word + length);
+}
+
+static int _PreprocessorDefineLine(PreprocessorSource_t *source, const char *line, int continued)
+{
+    PreprocessorMacro_t *macro = _definingMacro;
+    const char *word;
+    size_t length, need;
+    char *body;
+
+    if (!continued && (word = _PreprocessorWord(line, &length)) != NULL)
+    {
+        if (_PreprocessorIsWord(word, length, "endmacro"))
+        {
+            _definingMacro = NULL;
+            if (AVL_Insert(_macros, macro) != 1)
+            {
+                _Preprocessor_free_PreprocessorMacro(macro);
+                return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, NULL);
+            }
+            return _PREPROCESSOR_CONSUMED;
+        }
+        else if (_PreprocessorIsWord(word, length, "macro"))
+            return _PreprocessorError(source, PREPROCESSOR_ERROR_MALFORMED_DIRECTIVE, "macro");
+    }
+
+    // Stored as read, pieces of an overlong line join up again on expansion
+    length = strlen(line);
+    if ((need = macro->length + length) > macro->capacity)
+    {
+        need = need > macro->capacity * 2 ? need : macro->capacity * 2;
+        if ((body = (char *)realloc(macro->body, need)) == NULL)
+            return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, NULL);
+        MemoryAllocated(MEMORY_PREPROCESSOR, need - macro->capacity);
+        macro->body = body;
+        macro->capacity = need;
+    }
+    memcpy(macro->body + macro->length, line, length);
+    macro->length += length;
+    return _PREPROCESSOR_CONSUMED;
+}
+
+static int _PreprocessorInclude(PreprocessorSource_t *source, char *rest)
+{
+    char path[_PREPROCESSOR_PATH_LENGTH];
+    PreprocessorInclude_t *include;
+    PreprocessorSource_t *target;
+    size_t length;
+    int r;
+
+    rest = _PreprocessorTrim(rest);
+    length = strlen(rest);
+    if (length < 2 || rest[0] != '"' || rest[length - 1] != '"')
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_MALFORMED_DIRECTIVE, rest);
+    rest[length - 1] = '\0';
+    rest += 1;
+
+    if (_PreprocessorResolve(path, sizeof(path), rest) != 0)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_CANNOT_INCLUDE, rest);
+    if ((r = _PreprocessorLoad(path, &include)) != 0)
+        return _PreprocessorError(source, r, path);
+    if (include->generation == _generation)
+        return _PREPROCESSOR_CONSUMED; // Already included by this top-level file
+    if (_depth == _PREPROCESSOR_MAX_DEPTH)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_TOO_DEEP, path);
+
+    include->generation = _generation;
+    target = &_sources[_depth];
+    memset(target, 0, sizeof(*target));
+    target->name = target->path = include->path;
+    target->data = include->data;
+    target->length = include->length;
+    _depth += 1;
+    _pushes += 1;
+    return _PREPROCESSOR_CONSUMED;
+}
+
+static int _PreprocessorBeginMacro(PreprocessorSource_t *source, char *rest)
+{
+    PreprocessorMacro_t *macro;
+    size_t length;
+
+    rest = _PreprocessorTrim(rest);
+    if ((length = _PreprocessorIdentifierLength(rest)) == 0)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_MALFORMED_DIRECTIVE, rest);
+    if ((macro = (PreprocessorMacro_t *)calloc(1, sizeof(*macro))) == NULL || (macro->name = _PreprocessorCopy(rest, length)) == NULL)
+    {
+        free(macro);
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, NULL);
+    }
+    if (_Preprocessor_retrieveMacro(_macros, macro->name) != NULL)
+    {
+        _Preprocessor_free_PreprocessorMacro(macro);
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_MACRO_REDEFINED, rest);
+    }
+
+    rest += length;
+    for (;;)
+    {
+        while (*rest == ' ' || *rest == '\t' || *rest == ',')
+            rest += 1;
+        if (*rest == '\0')
+            break;
+        if ((length = _PreprocessorIdentifierLength(rest)) == 0 || macro->parameterCount == _PREPROCESSOR_MAX_PARAMETERS)
+        {
+            _Preprocessor_free_PreprocessorMacro(macro);
+            return _PreprocessorError(source, PREPROCESSOR_ERROR_MALFORMED_DIRECTIVE, rest);
+        }
+        if ((macro->parameters[macro->parameterCount] = _PreprocessorCopy(rest, length)) == NULL)
+        {
+            _Preprocessor_free_PreprocessorMacro(macro);
+            return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, NULL);
+        }
+        macro->parameterCount += 1;
+        rest += length;
+    }
+
+    _definingMacro = macro;
+    _definingDepth = _depth;
+    return _PREPROCESSOR_CONSUMED;
+}
+
+/* Push the body as a new source; substitution happens line by line as it is read. */
+static int _PreprocessorExpand(PreprocessorSource_t *source, const PreprocessorMacro_t *macro, char *rest)
+{
+    PreprocessorSource_t *target;
+    char *storage, *p, *comma;
+    int count;
+
+    if (_depth == _PREPROCESSOR_MAX_DEPTH)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_TOO_DEEP, macro->name);
+    if ((storage = strdup(_PreprocessorTrim(rest))) == NULL)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, NULL);
+
+    target = &_sources[_depth];
+    memset(target, 0, sizeof(*target));
+    count = 0;
+    for (p = storage; *p != '\0'; p = comma + 1)
+    {
+        if (count == _PREPROCESSOR_MAX_PARAMETERS)
+        {
+            count += 1;
+            break;
+        }
+        if ((comma = strchr(p, ',')) != NULL)
+            *comma = '\0';
+        target->arguments[count++] = _PreprocessorTrim(p);
+        if (comma == NULL)
+            break;
+    }
+    if (count != macro->parameterCount)
+    {
+        free(storage);
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_MACRO_ARGUMENTS, macro->name);
+    }
+
+    target->name = macro->name;
+    target->macro = macro;
+    target->data = macro->body;
+    target->length = macro->length;
+    target->argumentStorage = storage;
+    _depth += 1;
+    _pushes += 1;
+    return _PREPROCESSOR_CONSUMED;
+}
+
+/* Find the file in the cache, reading it again only when its size or mtime changed. */
+static int _PreprocessorLoad(const char *path, PreprocessorInclude_t **include)
+{
+    PreprocessorInclude_t *entry;
+    struct stat st;
+    char *data;
+    size_t n;
+    FILE *f;
+
+    if (stat(path, &st) != 0)
+        return PREPROCESSOR_ERROR_CANNOT_INCLUDE;
+
+    entry = (PreprocessorInclude_t *)_Preprocessor_retrieveInclude(_includeCache, path);
+    *include = entry;
+    if (entry && (entry->generation == _generation || (entry->mtime == st.st_mtime && entry->size == st.st_size)))
+        return 0;
+
+    if ((data = (char *)malloc((size_t)st.st_size + 1)) == NULL)
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    if ((f = fopen(path, "rb")) == NULL)
+    {
+        free(data);
+        return PREPROCESSOR_ERROR_CANNOT_INCLUDE;
+    }
+    n = fread(data, 1, (size_t)st.st_size, f);
+    fclose(f);
+    if (n != (size_t)st.st_size)
+    {
+        free(data);
+        return PREPROCESSOR_ERROR_CANNOT_READ;
+    }
+
+    if (entry == NULL)
+    {
+        if ((entry = (PreprocessorInclude_t *)calloc(1, sizeof(*entry))) == NULL || (entry->path = strdup(path)) == NULL)
+        {
+            free(entry);
+            free(data);
+            return PREPROCESSOR_ERROR_NO_MEMORY;
+        }
+        if (AVL_Insert(_includeCache, entry) != 1)
+        {
+            free(data);
+            _Preprocessor_free_PreprocessorInclude(entry);
+            return PREPROCESSOR_ERROR_NO_MEMORY;
+        }
+    }
+    else
+    {
+        MemoryReleased(MEMORY_PREPROCESSOR, entry->length + 1);
+        free(entry->data);
+    }
+    MemoryAllocated(MEMORY_PREPROCESSOR, n + 1);
+    entry->data = data;
+    entry->length = n;
+    entry->mtime = st.st_mtime;
+    entry->size = st.st_size;
+    *include = entry;
+    return 0;
+}
+
+/* Relative paths start from the directory of the innermost file being read. */
+static int _PreprocessorResolve(char *path, size_t size, const char *name)
+{
+    const char *base, *slash;
+    int i, n;
+
+    base = NULL;
+    for (i = _depth - 1; i >= 0 && base == NULL; i -= 1)
+        base = _sources[i].path;
+
+    if (name[0] == '/' || base == NULL || (slash = strrchr(base, '/')) == NULL)
+        n = snprintf(path, size, "%s", name);
+    else
+        n = snprintf(path, size, "%.*s/%s", (int)(slash - base), base, name);
+    return (n < 0 || (size_t)n >= size) ? 1 : 0;
+}
+
+static void _PreprocessorPop(void)
+{
+    _depth -= 1;
+    _pushes += 1;
+    free(_sources[_depth].argumentStorage);
+    _sources[_depth].argumentStorage = NULL;
+}
+
+/* Next line of source, starting a span when the line does not follow the last one. */
+static int _PreprocessorCountLine(const PreprocessorSource_t *source)
+{
+    PreprocessorSpan_t *spans;
+    unsigned int name;
+    size_t capacity;
+
+    _position += 1;
+    if (_spanCount && _spanPushes == _pushes)
+        return 0;
+    if (_spanCount == _spanCapacity)
+    {
+        capacity = _spanCapacity ? 2 * _spanCapacity : 64;
+        if ((spans = (PreprocessorSpan_t *)realloc(_spans, capacity * sizeof(*spans))) == NULL)
+            return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, source->name);
+        MemoryAllocated(MEMORY_PREPROCESSOR, (capacity - _spanCapacity) * sizeof(*spans));
+        _spans = spans;
+        _spanCapacity = capacity;
+    }
+    if (_PreprocessorSpanName(source->name, &name) != 0)
+        return _PreprocessorError(source, PREPROCESSOR_ERROR_NO_MEMORY, source->name);
+    _spans[_spanCount].position = _position;
+    _spans[_spanCount].name = name;
+    _spans[_spanCount].line = source->line;
+    _spanCount += 1;
+    _spanPushes = _pushes;
+    return 0;
+}
+
+/* Names are copied, macros and the top-level path are freed at close. */
+static int _PreprocessorSpanName(const char *name, unsigned int *index)
+{
+    char **names;
+    unsigned int i;
+
+    for (i = _spanNameCount; i > 0; i -= 1)
+        if (strcmp(_spanNames[i - 1], name) == 0)
+        {
+            *index = i - 1;
+            return 0;
+        }
+    if ((names = (char **)realloc(_spanNames, (_spanNameCount + 1) * sizeof(*names))) == NULL)
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    _spanNames = names;
+    if ((names[_spanNameCount] = strdup(name)) == NULL)
+        return PREPROCESSOR_ERROR_NO_MEMORY;
+    *index = _spanNameCount++;
+    return 0;
+}
+
+static void _PreprocessorClearSpans(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < _spanNameCount; i += 1)
+        free(_spanNames[i]);
+    free(_spanNames);
+    _spanNames = NULL;
+    _spanNameCount = 0;
+    _spanCount = 0;
+    _spanFound = 0;
+    _position = 0;
+}
+
+static int _PreprocessorError(const PreprocessorSource_t *source, int code, const char *subject)
+{
+    snprintf(_errorSource, sizeof(_errorSource), "%s", source->name);
+    snprintf(_errorSubject, sizeof(_errorSubject), "%s", subject ? subject : "");
+    _errorLine = source->line;
+    return _errorCode = code;
+}
+
+// ================================
+
+/* The word right after a leading '#', or NULL when the line is not a directive. */
+static const char *_PreprocessorWord(const char *line, size_t *length)
+{
+    while (*line == ' ' || *line == '\t')
+        line += 1;
+    if (*line != '#')
+        return NULL;
+    line += 1;
+    if ((*length = _PreprocessorIdentifierLength(line)) == 0)
+        return NULL;
+    return line;
+}
+
+static int _PreprocessorIsWord(const char *word, size_t length, const char *keyword)
+{
+    return strlen(keyword) == length && memcmp(word, keyword, length) == 0;
+}
+
+static size_t _PreprocessorIdentifierLength(const char *string)
+{
+    size_t n = 0;
+
+    while (isalnum((unsigned char)string[n]) || string[n] == '_' || string[n] == '.' || string[n] == '$' || string[n] == ':')
+        n += 1;
+    return n;
+}
+
+/* Cut a trailing comment and strip blanks on both sides, in place. */
+static char *_PreprocessorTrim(char *string)
+{
+    char *end;
+
+    while (*string == ' ' || *string == '\t')
+        string += 1;
+    if ((end = strstr(string, "//")) == NULL)
+        end = string + strlen(string);
+    while (end > string && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+        end -= 1;
+    *end = '\0';
+    return string;
+}
+
+static char *_PreprocessorCopy(const char *string, size_t length)
+{
+    char *copy;
+
+    if ((copy = (char *)malloc(length + 1)) == NULL)
+        return NULL;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
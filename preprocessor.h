@@ -0,0 +1,48 @@
+#ifndef _PREPROCESSOR_H_LOADED
+#define _PREPROCESSOR_H_LOADED
+
+/*
+    Line source in front of the parser, expanding directives while lines are read.
+
+    Directives (the '#' must be the first non-blank character):
+        #include "path"             Insert a file, relative to the including file.
+                                    A file is inserted at most once per top-level file.
+        #macro NAME a, b ...        Start a macro body with parameters a, b ...
+        #endmacro                   End the macro body.
+        #NAME x, y ...              Expand NAME, replacing {a}, {b} ... with x, y ...
+
+    Any other '#' line is passed through and stays a comment.
+    Included files are kept in memory and reused while their size and mtime do not change;
+    macro bodies are expanded one line at a time as the parser asks for them.
+*/
+
+int PreprocessorOpen(const char *filename);
+int PreprocessorClose(void);
+int PreprocessorReadLine(char *buffer, int size);
+int PreprocessorEof(void);
+unsigned int PreprocessorLineNumber(void);
+const char *PreprocessorSourceName(void);
+/* Every line read gets a position; the source and line of a position stay known after
+   the close, until the next open, so that instructions can keep the position alone. */
+unsigned int PreprocessorPosition(void);
+int PreprocessorLocate(unsigned int position, const char **source, unsigned int *line);
+int PreprocessorLastError(const char **source, unsigned int *line, const char **subject);
+void PreprocessorClearCache(void);
+/* Read the top-level files ahead on a thread (pipeline.h), from the next open on. */
+void PreprocessorSetReadAhead(int enabled);
+
+#define PREPROCESSOR_ERROR_ALREADY_OPENED 1
+#define PREPROCESSOR_ERROR_CANNOT_OPEN 2
+#define PREPROCESSOR_ERROR_FILE_CLOSED 3
+#define PREPROCESSOR_ERROR_EOF_REACHED 4
+#define PREPROCESSOR_ERROR_CANNOT_READ 5
+#define PREPROCESSOR_ERROR_NO_MEMORY 6
+#define PREPROCESSOR_ERROR_MALFORMED_DIRECTIVE 7
+#define PREPROCESSOR_ERROR_CANNOT_INCLUDE 8
+#define PREPROCESSOR_ERROR_TOO_DEEP 9
+#define PREPROCESSOR_ERROR_MACRO_REDEFINED 10
+#define PREPROCESSOR_ERROR_MACRO_ARGUMENTS 11
+#define PREPROCESSOR_ERROR_UNTERMINATED_MACRO 12
+#define PREPROCESSOR_ERROR_STRAY_ENDMACRO 13
+
+#endif
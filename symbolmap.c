@@ -0,0 +1,195 @@
+#include "symbolmap.h"
+#include "symboltable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _SYMBOL_MAP_KIND_COUNT 3
+
+typedef struct
+{
+    unsigned int address;
+    unsigned int nameOffset;
+    int kind;
+} SymbolMapRecord_t;
+
+typedef struct
+{
+    SymbolMapRecord_t *records;
+    size_t recordCount;
+    size_t recordCapacity;
+    char *pool;
+    size_t poolLength;
+    size_t poolCapacity;
+    int failed;
+} SymbolMapCollector_t;
+
+static int _SymbolMap_collect(const char *symbol, int address, int kind, void *param);
+static int _SymbolMap_cmp_SymbolMapRecord(const void *a, const void *b);
+static int _SymbolMap_writeBinary(FILE *f, const SymbolMapCollector_t *collector);
+static int _SymbolMap_writeText(FILE *f, const SymbolMapCollector_t *collector);
+static int _SymbolMap_writeUInt32(FILE *f, unsigned int value);
+
+// Kinds in the order they are written
+static const int _symbolMapKindOrder[_SYMBOL_MAP_KIND_COUNT] = {SYMBOL_KIND_LABEL, SYMBOL_KIND_VARIABLE, SYMBOL_KIND_BUILTIN};
+static const char _symbolMapKindLetter[_SYMBOL_MAP_KIND_COUNT] = {'B', 'L', 'V'};
+
+int SymbolMapWrite(const char *filename, int format)
+{
+    SymbolMapCollector_t collector;
+    FILE *f;
+    int r;
+
+    if (format != SYMBOL_MAP_FORMAT_BINARY && format != SYMBOL_MAP_FORMAT_TEXT)
+        return SYMBOL_MAP_ERROR_UNKNOWN_FORMAT;
+
+    memset(&collector, 0, sizeof(collector));
+    SymbolTableForEach("", _SymbolMap_collect, &collector);
+    if (collector.failed)
+    {
+        free(collector.records);
+        free(collector.pool);
+        return SYMBOL_MAP_ERROR_NO_MEMORY;
+    }
+    // Names were visited in order, so ties on address keep name order through the pool offsets
+    qsort(collector.records, collector.recordCount, sizeof(*collector.records), _SymbolMap_cmp_SymbolMapRecord);
+
+    f = fopen(filename, (format == SYMBOL_MAP_FORMAT_BINARY) ? "wb" : "w");
+    if (f == NULL)
+        r = SYMBOL_MAP_ERROR_CANNOT_OPEN;
+    else
+    {
+        if (format == SYMBOL_MAP_FORMAT_BINARY)
+            r = _SymbolMap_writeBinary(f, &collector);
+        else
+            r = _SymbolMap_writeText(f, &collector);
+        if (fclose(f) != 0 && r == 0)
+            r = SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    }
+
+    free(collector.records);
+    free(collector.pool);
+    return r;
+}
+
+// ================================
+
+static int _SymbolMap_collect(const char *symbol, int address, int kind, void *param)
+{
+    SymbolMapCollector_t *collector = (SymbolMapCollector_t *)param;
+    SymbolMapRecord_t *records;
+    char *pool;
+    size_t length, capacity;
+
+    if (collector->recordCount == collector->recordCapacity)
+    {
+        capacity = collector->recordCapacity ? collector->recordCapacity * 2 : 64;
+        records = (SymbolMapRecord_t *)realloc(collector->records, capacity * sizeof(*records));
+        if (records == NULL)
+            goto _SymbolMap_collect_failure;
+        collector->records = records;
+        collector->recordCapacity = capacity;
+    }
+    length = strlen(symbol) + 1;
+    if (collector->poolLength + length > collector->poolCapacity)
+    {
+        capacity = collector->poolCapacity ? collector->poolCapacity * 2 : 1024;
+        while (collector->poolLength + length > capacity)
+            capacity *= 2;
+        pool = (char *)realloc(collector->pool, capacity);
+        if (pool == NULL)
+            goto _SymbolMap_collect_failure;
+        collector->pool = pool;
+        collector->poolCapacity = capacity;
+    }
+
+    collector->records[collector->recordCount].address = (unsigned int)address;
+    collector->records[collector->recordCount].nameOffset = (unsigned int)collector->poolLength;
+    collector->records[collector->recordCount].kind = kind;
+    collector->recordCount += 1;
+    memcpy(collector->pool + collector->poolLength, symbol, length);
+    collector->poolLength += length;
+    return 0;
+
+_SymbolMap_collect_failure:
+    collector->failed = 1;
+    return 1;
+}
+
+static int _SymbolMap_cmp_SymbolMapRecord(const void *a, const void *b)
+{
+    const SymbolMapRecord_t *c = (const SymbolMapRecord_t *)a;
+    const SymbolMapRecord_t *d = (const SymbolMapRecord_t *)b;
+    int i, j;
+
+    for (i = 0; _symbolMapKindOrder[i] != c->kind; i += 1)
+        ;
+    for (j = 0; _symbolMapKindOrder[j] != d->kind; j += 1)
+        ;
+    if (i != j)
+        return i - j;
+    if (c->address != d->address)
+        return (c->address > d->address) ? 1 : -1;
+    if (c->nameOffset != d->nameOffset)
+        return (c->nameOffset > d->nameOffset) ? 1 : -1;
+    return 0;
+}
+
+static int _SymbolMap_writeBinary(FILE *f, const SymbolMapCollector_t *collector)
+{
+    unsigned int counts[_SYMBOL_MAP_KIND_COUNT];
+    size_t i;
+    int j;
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < collector->recordCount; i += 1)
+        for (j = 0; j < _SYMBOL_MAP_KIND_COUNT; j += 1)
+            if (_symbolMapKindOrder[j] == collector->records[i].kind)
+                counts[j] += 1;
+
+    if (fwrite("HSYM", 1, 4, f) != 4)
+        return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    if (_SymbolMap_writeUInt32(f, SYMBOL_MAP_VERSION))
+        return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    for (j = 0; j < _SYMBOL_MAP_KIND_COUNT; j += 1)
+        if (_SymbolMap_writeUInt32(f, counts[j]))
+            return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    if (_SymbolMap_writeUInt32(f, (unsigned int)collector->poolLength))
+        return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    for (i = 0; i < collector->recordCount; i += 1)
+    {
+        if (_SymbolMap_writeUInt32(f, collector->records[i].address))
+            return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+        if (_SymbolMap_writeUInt32(f, collector->records[i].nameOffset))
+            return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    }
+    if (fwrite(collector->pool, 1, collector->poolLength, f) != collector->poolLength)
+        return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    return 0;
+}
+
+static int _SymbolMap_writeText(FILE *f, const SymbolMapCollector_t *collector)
+{
+    const SymbolMapRecord_t *record;
+    size_t i;
+
+    for (i = 0; i < collector->recordCount; i += 1)
+    {
+        record = collector->records + i;
+        if (fprintf(f, "%c %u %s\n", _symbolMapKindLetter[record->kind], record->address, collector->pool + record->nameOffset) < 0)
+            return SYMBOL_MAP_ERROR_CANNOT_WRITE;
+    }
+    return 0;
+}
+
+static int _SymbolMap_writeUInt32(FILE *f, unsigned int value)
+{
+    unsigned char bytes[4];
+
+    bytes[0] = (unsigned char)(value & 0xFF);
+    bytes[1] = (unsigned char)((value >> 8) & 0xFF);
+    bytes[2] = (unsigned char)((value >> 16) & 0xFF);
+    bytes[3] = (unsigned char)((value >> 24) & 0xFF);
+    return (fwrite(bytes, 1, 4, f) != 4) ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+#ifndef _SYMBOL_MAP_H_LOADED
+#define _SYMBOL_MAP_H_LOADED
+
+/*
+    Symbol map written from the symbol table in a single sweep.
+
+    Binary format, every field a little-endian 32-bit unsigned integer:
+        magic "HSYM", version,
+        label count, variable count, builtin count, string pool size,
+        records { address, name offset } of labels, then variables, then builtins,
+            each group sorted by address (ties by name),
+        string pool of NUL-terminated names.
+
+    Text format, one symbol per line in the same order:
+        <L|V|B> <address> <name>
+*/
+
+#define SYMBOL_MAP_FORMAT_BINARY 1
+#define SYMBOL_MAP_FORMAT_TEXT 2
+
+#define SYMBOL_MAP_VERSION 1
+
+int SymbolMapWrite(const char *filename, int format);
+
+#define SYMBOL_MAP_ERROR_CANNOT_OPEN 1
+#define SYMBOL_MAP_ERROR_NO_MEMORY 2
+#define SYMBOL_MAP_ERROR_CANNOT_WRITE 3
+#define SYMBOL_MAP_ERROR_UNKNOWN_FORMAT 4
+
+#endif
@@ -1,131 +1,157 @@
 #include "symboltable.h"
 #include "avl_tree.h"
+#include "memory.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#define _SYMBOL_TABLE_NODES_PER_BLOCK 256
+#define _SYMBOL_TABLE_CHUNK_SIZE 16384
+
 typedef struct
 {
     const char *symbol;
     int value;
+    int kind;
+    int id;
 } SymbolTableEntry_t;
 
+/* User entries and their names are carved from chunks that a reset rewinds and reuses. */
+typedef struct SymbolTableChunk
+{
+    struct SymbolTableChunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} SymbolTableChunk_t;
+
 static int _SymbolTable_cmp_SymbolTableEntry(void *a, void *b);
-static void _SymbolTable_free_SymbolTableEntry(void *p);
-static SymbolTableEntry_t *_SymbolTable_getBySymbol(const char *symbol);
+static const SymbolTableEntry_t *_SymbolTable_getBuiltIn(const char *symbol);
+static const SymbolTableEntry_t *_SymbolTable_getBySymbol(const char *symbol);
+static const SymbolTableEntry_t *_SymbolTable_getById(int id);
+static SymbolTableEntry_t *_SymbolTable_getUserById(int id);
+static int _SymbolTable_reserveId(void);
+static void *_SymbolTable_allocate(size_t size);
+static SymbolTableEntry_t *_SymbolTable_newEntry(const char *symbol, int address, int kind);
+static void _SymbolTable_account(void);
 
+AVL_DEFINE_STRING_RETRIEVE(_SymbolTable_retrieveBySymbol, SymbolTableEntry_t, symbol)
+
+// Base layer, in strcmp order so that the ID of a builtin is its index
 static const SymbolTableEntry_t _symbolTableBuiltIn[] = {
-    {"R0", 0},
-    {"R1", 1},
-    {"R2", 2},
-    {"R3", 3},
-    {"R4", 4},
-    {"R5", 5},
-    {"R6", 6},
-    {"R7", 7},
-    {"R8", 8},
-    {"R9", 9},
-    {"R10", 10},
-    {"R11", 11},
-    {"R12", 12},
-    {"R13", 13},
-    {"R14", 14},
-    {"R15", 15},
-    {"SCREEN", 16384},
-    {"KBD", 24576},
-    {"SP", 0},
-    {"LCL", 1},
-    {"ARG", 2},
-    {"THIS", 3},
-    {"THAT", 4}};
+    {"ARG", 2, SYMBOL_KIND_BUILTIN, 0},
+    {"KBD", 24576, SYMBOL_KIND_BUILTIN, 1},
+    {"LCL", 1, SYMBOL_KIND_BUILTIN, 2},
+    {"R0", 0, SYMBOL_KIND_BUILTIN, 3},
+    {"R1", 1, SYMBOL_KIND_BUILTIN, 4},
+    {"R10", 10, SYMBOL_KIND_BUILTIN, 5},
+    {"R11", 11, SYMBOL_KIND_BUILTIN, 6},
+    {"R12", 12, SYMBOL_KIND_BUILTIN, 7},
+    {"R13", 13, SYMBOL_KIND_BUILTIN, 8},
+    {"R14", 14, SYMBOL_KIND_BUILTIN, 9},
+    {"R15", 15, SYMBOL_KIND_BUILTIN, 10},
+    {"R2", 2, SYMBOL_KIND_BUILTIN, 11},
+    {"R3", 3, SYMBOL_KIND_BUILTIN, 12},
+    {"R4", 4, SYMBOL_KIND_BUILTIN, 13},
+    {"R5", 5, SYMBOL_KIND_BUILTIN, 14},
+    {"R6", 6, SYMBOL_KIND_BUILTIN, 15},
+    {"R7", 7, SYMBOL_KIND_BUILTIN, 16},
+    {"R8", 8, SYMBOL_KIND_BUILTIN, 17},
+    {"R9", 9, SYMBOL_KIND_BUILTIN, 18},
+    {"SCREEN", 16384, SYMBOL_KIND_BUILTIN, 19},
+    {"SP", 0, SYMBOL_KIND_BUILTIN, 20},
+    {"THAT", 4, SYMBOL_KIND_BUILTIN, 21},
+    {"THIS", 3, SYMBOL_KIND_BUILTIN, 22}};
+#define _SYMBOL_TABLE_BUILT_IN_COUNT (sizeof(_symbolTableBuiltIn) / sizeof(_symbolTableBuiltIn[0]))
+
+// Overlay of the current file, IDs from _SYMBOL_TABLE_BUILT_IN_COUNT on
 static AVL_TREE *_symbolTableTree = NULL;
+static SymbolTableEntry_t **_symbolTableById = NULL; // Indexed by ID - _SYMBOL_TABLE_BUILT_IN_COUNT
+static unsigned int _symbolTableCount = 0;           // Builtins included
+static unsigned int _symbolTableCapacity = 0;
+static SymbolTableChunk_t *_symbolTableChunks = NULL;
+static SymbolTableChunk_t *_symbolTableChunk = NULL; // The one being carved
+static size_t _symbolTableChunkBytes = 0;
+static size_t _symbolTableAccounted = 0; // Last total reported to the memory accounting
 
 int SymbolTableInit(void)
 {
-    size_t i, n;
-    SymbolTableEntry_t *entry;
-
     if (_symbolTableTree != NULL)
         return SYMBOL_TABLE_ERROR_TREE_CREATED;
 
-    _symbolTableTree = AVL_Create(_SymbolTable_cmp_SymbolTableEntry, _SymbolTable_free_SymbolTableEntry);
+    _symbolTableTree = AVL_CreatePooled(_SymbolTable_cmp_SymbolTableEntry, NULL, _SYMBOL_TABLE_NODES_PER_BLOCK);
     if (_symbolTableTree == NULL)
         return SYMBOL_TABLE_ERROR_NO_MEMORY;
-
-    n = sizeof(_symbolTableBuiltIn) / sizeof(_symbolTableBuiltIn[0]);
-    for (i = 0; i < n; i += 1)
+    _symbolTableCount = _SYMBOL_TABLE_BUILT_IN_COUNT;
+    if (_SymbolTable_reserveId() != 0)
     {
-        entry = (SymbolTableEntry_t *)malloc(sizeof(*entry));
-        if (entry == NULL)
-        {
-            SymbolTableExit();
-            return SYMBOL_TABLE_ERROR_NO_MEMORY;
-        }
-        entry->symbol = (const char *)strdup(_symbolTableBuiltIn[i].symbol);
-        if (entry->symbol == NULL)
-        {
-            free(entry);
-            SymbolTableExit();
-            return SYMBOL_TABLE_ERROR_NO_MEMORY;
-        }
-        entry->value = _symbolTableBuiltIn[i].value;
-        memcpy(entry, _symbolTableBuiltIn + i, sizeof(*entry));
-        if (AVL_Insert(_symbolTableTree, entry) != 1)
-        {
-            _SymbolTable_free_SymbolTableEntry(entry);
-            SymbolTableExit();
-            return SYMBOL_TABLE_ERROR_NO_MEMORY;
-        }
+        SymbolTableExit();
+        return SYMBOL_TABLE_ERROR_NO_MEMORY;
     }
-
+    _SymbolTable_account();
     return 0;
 }
 
 int SymbolTableExit(void)
 {
+    SymbolTableChunk_t *next;
+
     if (_symbolTableTree == NULL)
         return SYMBOL_TABLE_ERROR_TREE_DESTROYED;
     AVL_Destroy(_symbolTableTree);
     _symbolTableTree = NULL;
+    free(_symbolTableById);
+    _symbolTableById = NULL;
+    _symbolTableCount = 0;
+    _symbolTableCapacity = 0;
+    for (; _symbolTableChunks != NULL; _symbolTableChunks = next)
+    {
+        next = _symbolTableChunks->next;
+        free(_symbolTableChunks);
+    }
+    _symbolTableChunk = NULL;
+    _symbolTableChunkBytes = 0;
+    _SymbolTable_account();
     return 0;
 }
 
-int addEntry(const char *symbol, int address)
+/* Only the overlay is cleared, the builtins are never copied. The chunks are kept for
+   the next file; the tree keeps its first pool block. */
+int SymbolTableReset(void)
 {
-    SymbolTableEntry_t *entry;
-
     if (_symbolTableTree == NULL)
         return SYMBOL_TABLE_ERROR_TREE_DESTROYED;
 
-    if (contains(symbol))
-        return SYMBOL_TABLE_ERROR_SYMBOL_EXIST;
+    AVL_Clear(_symbolTableTree);
+    _symbolTableCount = _SYMBOL_TABLE_BUILT_IN_COUNT;
+    _symbolTableChunk = _symbolTableChunks;
+    if (_symbolTableChunk != NULL)
+        _symbolTableChunk->used = 0;
+    _SymbolTable_account();
+    return 0;
+}
 
-    entry = (SymbolTableEntry_t *)malloc(sizeof(*entry));
-    if (entry == NULL)
-        return SYMBOL_TABLE_ERROR_NO_MEMORY;
+int addEntry(const char *symbol, int address, int kind)
+{
+    const SymbolTableEntry_t *entry;
 
-    entry->symbol = strdup(symbol);
-    if (entry->symbol == NULL)
-    {
-        free(entry);
-        return SYMBOL_TABLE_ERROR_NO_MEMORY;
-    }
-    entry->value = address;
+    if (_symbolTableTree == NULL)
+        return SYMBOL_TABLE_ERROR_TREE_DESTROYED;
 
-    if (AVL_Insert(_symbolTableTree, entry) != 1)
-    {
-        _SymbolTable_free_SymbolTableEntry(entry);
-        return SYMBOL_TABLE_ERROR_NO_MEMORY;
-    }
+    entry = _SymbolTable_getBySymbol(symbol);
+    if (entry != NULL)
+        return SymbolTableDefine(entry->id, address, kind);
 
+    if (_SymbolTable_newEntry(symbol, address, kind) == NULL)
+        return SYMBOL_TABLE_ERROR_NO_MEMORY;
     return 0;
 }
 
 int contains(const char *symbol)
 {
-    SymbolTableEntry_t *result = _SymbolTable_getBySymbol(symbol);
+    const SymbolTableEntry_t *result = _SymbolTable_getBySymbol(symbol);
 
-    if (result == NULL)
+    if (result == NULL || result->kind == SYMBOL_KIND_UNDEFINED)
         return 0;
     else
         return 1;
@@ -133,14 +159,135 @@ int contains(const char *symbol)
 
 int GetAddress(const char *symbol)
 {
-    SymbolTableEntry_t *result = _SymbolTable_getBySymbol(symbol);
+    const SymbolTableEntry_t *result = _SymbolTable_getBySymbol(symbol);
 
-    if (result == NULL)
+    if (result == NULL || result->kind == SYMBOL_KIND_UNDEFINED)
         return -1;
     else
         return result->value;
 }
 
+int SymbolTableIntern(const char *symbol)
+{
+    const SymbolTableEntry_t *entry;
+
+    if (_symbolTableTree == NULL)
+        return -SYMBOL_TABLE_ERROR_TREE_DESTROYED;
+
+    entry = _SymbolTable_getBySymbol(symbol);
+    if (entry == NULL && (entry = _SymbolTable_newEntry(symbol, -1, SYMBOL_KIND_UNDEFINED)) == NULL)
+        return -SYMBOL_TABLE_ERROR_NO_MEMORY;
+    return entry->id;
+}
+
+int SymbolTableFind(const char *symbol)
+{
+    const SymbolTableEntry_t *entry;
+
+    if (_symbolTableTree == NULL)
+        return -SYMBOL_TABLE_ERROR_TREE_DESTROYED;
+
+    if ((entry = _SymbolTable_getBySymbol(symbol)) == NULL)
+        return -SYMBOL_TABLE_ERROR_NO_SUCH_ID;
+    return entry->id;
+}
+
+int SymbolTableDefine(int id, int address, int kind)
+{
+    SymbolTableEntry_t *entry;
+
+    if (id >= 0 && (unsigned int)id < _SYMBOL_TABLE_BUILT_IN_COUNT)
+        return SYMBOL_TABLE_ERROR_SYMBOL_EXIST;
+    if ((entry = _SymbolTable_getUserById(id)) == NULL)
+        return SYMBOL_TABLE_ERROR_NO_SUCH_ID;
+    if (entry->kind != SYMBOL_KIND_UNDEFINED)
+        return SYMBOL_TABLE_ERROR_SYMBOL_EXIST;
+    entry->value = address;
+    entry->kind = kind;
+    return 0;
+}
+
+/* The builtins are read-only. */
+int SymbolTableSetAddress(int id, int address)
+{
+    SymbolTableEntry_t *entry = _SymbolTable_getUserById(id);
+
+    if (entry == NULL)
+        return SYMBOL_TABLE_ERROR_NO_SUCH_ID;
+    entry->value = address;
+    return 0;
+}
+
+unsigned int SymbolTableCount(void)
+{
+    return _symbolTableCount;
+}
+
+int SymbolTableKind(int id)
+{
+    const SymbolTableEntry_t *entry = _SymbolTable_getById(id);
+
+    return (entry == NULL) ? SYMBOL_KIND_UNDEFINED : entry->kind;
+}
+
+int SymbolTableAddress(int id)
+{
+    const SymbolTableEntry_t *entry = _SymbolTable_getById(id);
+
+    return (entry == NULL) ? -1 : entry->value;
+}
+
+const char *SymbolTableName(int id)
+{
+    const SymbolTableEntry_t *entry = _SymbolTable_getById(id);
+
+    return (entry == NULL) ? NULL : entry->symbol;
+}
+
+/* Merges the base layer and the overlay, both are already in name order. */
+unsigned int SymbolTableForEach(const char *prefix, SymbolTableVisit_t visit, void *param)
+{
+    AVL_ITERATOR it;
+    SymbolTableEntry_t key;
+    const SymbolTableEntry_t *builtIn, *user, *entry;
+    size_t i, length;
+    unsigned int count;
+
+    if (_symbolTableTree == NULL)
+        return 0;
+
+    key.symbol = prefix;
+    length = strlen(prefix);
+    count = 0;
+    for (i = 0; i < _SYMBOL_TABLE_BUILT_IN_COUNT && strcmp(_symbolTableBuiltIn[i].symbol, prefix) < 0; i += 1)
+        ;
+    user = (const SymbolTableEntry_t *)AVL_LowerBound(_symbolTableTree, &it, &key);
+    for (;;)
+    {
+        builtIn = (i < _SYMBOL_TABLE_BUILT_IN_COUNT && strncmp(_symbolTableBuiltIn[i].symbol, prefix, length) == 0) ? _symbolTableBuiltIn + i : NULL;
+        if (user != NULL && strncmp(user->symbol, prefix, length) != 0)
+            user = NULL;
+        if (builtIn == NULL && user == NULL)
+            break;
+        if (builtIn != NULL && (user == NULL || strcmp(builtIn->symbol, user->symbol) < 0))
+        {
+            entry = builtIn;
+            i += 1;
+        }
+        else
+        {
+            entry = user;
+            user = (const SymbolTableEntry_t *)AVL_Next(&it);
+        }
+        if (entry->kind == SYMBOL_KIND_UNDEFINED)
+            continue;
+        count += 1;
+        if (visit(entry->symbol, entry->value, entry->kind, param))
+            break;
+    }
+    return count;
+}
+
 // ================================
 
 static int _SymbolTable_cmp_SymbolTableEntry(void *a, void *b)
@@ -151,21 +298,140 @@ static int _SymbolTable_cmp_SymbolTableEntry(void *a, void *b)
     return strcmp(c->symbol, d->symbol);
 }
 
-static void _SymbolTable_free_SymbolTableEntry(void *p)
+static const SymbolTableEntry_t *_SymbolTable_getBuiltIn(const char *symbol)
 {
-    SymbolTableEntry_t *q = (SymbolTableEntry_t *)p;
+    size_t low, high, middle;
+    int c;
 
-    free((void *)q->symbol);
-    free(q);
+    for (low = 0, high = _SYMBOL_TABLE_BUILT_IN_COUNT; low < high;)
+    {
+        middle = (low + high) / 2;
+        if ((c = strcmp(symbol, _symbolTableBuiltIn[middle].symbol)) == 0)
+            return _symbolTableBuiltIn + middle;
+        if (c < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return NULL;
 }
 
-static SymbolTableEntry_t *_SymbolTable_getBySymbol(const char *symbol)
+static const SymbolTableEntry_t *_SymbolTable_getBySymbol(const char *symbol)
 {
-    SymbolTableEntry_t key;
+    const SymbolTableEntry_t *result;
 
     if (_symbolTableTree == NULL)
         return NULL;
+    if ((result = _SymbolTable_getBuiltIn(symbol)) != NULL)
+        return result;
+    return (const SymbolTableEntry_t *)_SymbolTable_retrieveBySymbol(_symbolTableTree, symbol);
+}
+
+static const SymbolTableEntry_t *_SymbolTable_getById(int id)
+{
+    if (id >= 0 && (unsigned int)id < _SYMBOL_TABLE_BUILT_IN_COUNT)
+        return _symbolTableBuiltIn + id;
+    return _SymbolTable_getUserById(id);
+}
 
-    key.symbol = symbol;
-    return (SymbolTableEntry_t *)AVL_Retrieve(_symbolTableTree, &key);
+static SymbolTableEntry_t *_SymbolTable_getUserById(int id)
+{
+    if (id < (int)_SYMBOL_TABLE_BUILT_IN_COUNT || (unsigned int)id >= _symbolTableCount)
+        return NULL;
+    return _symbolTableById[id - (int)_SYMBOL_TABLE_BUILT_IN_COUNT];
+}
+
+static int _SymbolTable_reserveId(void)
+{
+    SymbolTableEntry_t **byId;
+    unsigned int capacity;
+
+    if (_symbolTableCount - _SYMBOL_TABLE_BUILT_IN_COUNT < _symbolTableCapacity)
+        return 0;
+    capacity = _symbolTableCapacity ? _symbolTableCapacity * 2 : _SYMBOL_TABLE_NODES_PER_BLOCK;
+    byId = (SymbolTableEntry_t **)realloc(_symbolTableById, capacity * sizeof(*byId));
+    if (byId == NULL)
+        return SYMBOL_TABLE_ERROR_NO_MEMORY;
+    _symbolTableById = byId;
+    _symbolTableCapacity = capacity;
+    return 0;
+}
+
+/* Bump allocation; a full chunk moves on to the next one kept from an earlier file. */
+static void *_SymbolTable_allocate(size_t size)
+{
+    SymbolTableChunk_t *chunk;
+    size_t chunkSize;
+    void *p;
+
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    chunk = _symbolTableChunk;
+    while (chunk == NULL || chunk->used + size > chunk->size)
+    {
+        if (chunk != NULL && chunk->next != NULL)
+        {
+            chunk = chunk->next;
+            chunk->used = 0;
+            continue;
+        }
+        chunkSize = (size > _SYMBOL_TABLE_CHUNK_SIZE) ? size : _SYMBOL_TABLE_CHUNK_SIZE;
+        p = malloc(sizeof(SymbolTableChunk_t) + chunkSize);
+        if (p == NULL)
+            return NULL;
+        ((SymbolTableChunk_t *)p)->next = NULL;
+        ((SymbolTableChunk_t *)p)->size = chunkSize;
+        ((SymbolTableChunk_t *)p)->used = 0;
+        _symbolTableChunkBytes += sizeof(SymbolTableChunk_t) + chunkSize;
+        if (chunk == NULL)
+            _symbolTableChunks = (SymbolTableChunk_t *)p;
+        else
+            chunk->next = (SymbolTableChunk_t *)p;
+        chunk = (SymbolTableChunk_t *)p;
+    }
+    _symbolTableChunk = chunk;
+    p = chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+static SymbolTableEntry_t *_SymbolTable_newEntry(const char *symbol, int address, int kind)
+{
+    SymbolTableEntry_t *entry;
+    size_t length;
+    char *name;
+
+    if (_SymbolTable_reserveId() != 0)
+        return NULL;
+
+    length = strlen(symbol) + 1;
+    entry = (SymbolTableEntry_t *)_SymbolTable_allocate(sizeof(*entry) + length);
+    if (entry == NULL)
+        return NULL;
+    name = (char *)(entry + 1);
+    memcpy(name, symbol, length);
+    entry->symbol = name;
+    entry->value = address;
+    entry->kind = kind;
+    entry->id = (int)_symbolTableCount;
+
+    // The chunk space is not handed back, the next reset rewinds it anyway
+    if (AVL_Insert(_symbolTableTree, entry) != 1)
+        return NULL;
+    _symbolTableById[_symbolTableCount++ - _SYMBOL_TABLE_BUILT_IN_COUNT] = entry;
+    _SymbolTable_account();
+    return entry;
+}
+
+/* Reports the change since the last call, everything is gone once the tree is destroyed. */
+static void _SymbolTable_account(void)
+{
+    size_t bytes = 0;
+
+    if (_symbolTableTree != NULL)
+        bytes = AVL_MemoryUsage(_symbolTableTree) + _symbolTableChunkBytes + _symbolTableCapacity * sizeof(*_symbolTableById);
+    if (bytes > _symbolTableAccounted)
+        MemoryAllocated(MEMORY_SYMBOL_TABLE, bytes - _symbolTableAccounted);
+    else
+        MemoryReleased(MEMORY_SYMBOL_TABLE, _symbolTableAccounted - bytes);
+    _symbolTableAccounted = bytes;
 }
@@ -3,14 +3,39 @@
 
 int SymbolTableInit(void);
 int SymbolTableExit(void);
+/* Back to the builtins only, for the next file. Cheaper than Exit and Init. */
+int SymbolTableReset(void);
 
-int addEntry(const char *symbol, int address);
+#define SYMBOL_KIND_BUILTIN 0
+#define SYMBOL_KIND_LABEL 1
+#define SYMBOL_KIND_VARIABLE 2
+#define SYMBOL_KIND_UNDEFINED 3
+
+int addEntry(const char *symbol, int address, int kind);
 int contains(const char *symbol);
 int GetAddress(const char *symbol);
 
+/* Every distinct spelling gets a dense ID in first-seen order; the builtins come first.
+   SymbolTableIntern returns the ID, or a negated SYMBOL_TABLE_ERROR_* code. */
+int SymbolTableIntern(const char *symbol);
+/* Like SymbolTableIntern, but -SYMBOL_TABLE_ERROR_NO_SUCH_ID for a symbol never seen. */
+int SymbolTableFind(const char *symbol);
+int SymbolTableDefine(int id, int address, int kind);
+int SymbolTableSetAddress(int id, int address);
+unsigned int SymbolTableCount(void);
+int SymbolTableKind(int id);
+int SymbolTableAddress(int id);
+const char *SymbolTableName(int id);
+
+/* Visit the symbols starting with prefix ("" for all) in name order.
+   Stops early when visit returns non-zero. Returns the number of symbols visited. */
+typedef int (*SymbolTableVisit_t)(const char *symbol, int address, int kind, void *param);
+unsigned int SymbolTableForEach(const char *prefix, SymbolTableVisit_t visit, void *param);
+
 #define SYMBOL_TABLE_ERROR_NO_MEMORY 1
 #define SYMBOL_TABLE_ERROR_TREE_DESTROYED 2
 #define SYMBOL_TABLE_ERROR_TREE_CREATED 3
 #define SYMBOL_TABLE_ERROR_SYMBOL_EXIST 4
+#define SYMBOL_TABLE_ERROR_NO_SUCH_ID 5
 
 #endif
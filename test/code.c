@@ -0,0 +1,74 @@
+/*
+    Regression test of the Code tables against the Hack specification.
+
+    Usage: code
+
+    Every dest, comp and jump mnemonic must translate to the bit string of the
+    specification, with all of its digits: the C word is packed from these strings,
+    and a short one can come out right by accident.
+*/
+
+#include "../code.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+    const char *mnemonic;
+    const char *bitString;
+} TestCase_t;
+
+static const TestCase_t _testComp[] = {
+    {"0", "0101010"}, {"1", "0111111"}, {"-1", "0111010"}, {"D", "0001100"},
+    {"A", "0110000"}, {"!D", "0001101"}, {"!A", "0110001"}, {"-D", "0001111"},
+    {"-A", "0110011"}, {"D+1", "0011111"}, {"A+1", "0110111"}, {"D-1", "0001110"},
+    {"A-1", "0110010"}, {"D+A", "0000010"}, {"D-A", "0010011"}, {"A-D", "0000111"},
+    {"D&A", "0000000"}, {"D|A", "0010101"}, {"M", "1110000"}, {"!M", "1110001"},
+    {"-M", "1110011"}, {"M+1", "1110111"}, {"M-1", "1110010"}, {"D+M", "1000010"},
+    {"D-M", "1010011"}, {"M-D", "1000111"}, {"D&M", "1000000"}, {"D|M", "1010101"}};
+
+static const TestCase_t _testDest[] = {
+    {"M", "001"}, {"D", "010"}, {"MD", "011"}, {"A", "100"},
+    {"AM", "101"}, {"AD", "110"}, {"AMD", "111"}};
+
+static const TestCase_t _testJump[] = {
+    {"JGT", "001"}, {"JEQ", "010"}, {"JGE", "011"}, {"JLT", "100"},
+    {"JNE", "101"}, {"JLE", "110"}, {"JMP", "111"}};
+
+static unsigned int _TestTable(const char *name, const char *(*translate)(const char *), const TestCase_t *cases, size_t count);
+
+int main(void)
+{
+    unsigned int failures;
+
+    failures = _TestTable("comp", Code_comp, _testComp, sizeof(_testComp) / sizeof(_testComp[0]));
+    failures += _TestTable("dest", Code_dest, _testDest, sizeof(_testDest) / sizeof(_testDest[0]));
+    failures += _TestTable("jump", Code_jump, _testJump, sizeof(_testJump) / sizeof(_testJump[0]));
+    if (failures)
+    {
+        fprintf(stderr, "%u mnemonic(s) do not match the specification.\n", failures);
+        return 1;
+    }
+    printf("All dest, comp and jump mnemonics match the specification.\n");
+    return 0;
+}
+
+static unsigned int _TestTable(const char *name, const char *(*translate)(const char *), const TestCase_t *cases, size_t count)
+{
+    const char *bitString;
+    unsigned int failures;
+    size_t i;
+
+    failures = 0;
+    for (i = 0; i < count; i += 1)
+    {
+        bitString = translate(cases[i].mnemonic);
+        if (bitString == NULL || strcmp(bitString, cases[i].bitString) != 0)
+        {
+            fprintf(stderr, "%s '%s': expected %s, got %s.\n", name, cases[i].mnemonic, cases[i].bitString, bitString ? bitString : "(null)");
+            failures += 1;
+        }
+    }
+    return failures;
+}
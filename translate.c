@@ -0,0 +1,262 @@
+#include "translate.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _TRANSLATE_EXPRESSION_LENGTH 64
+
+// zx nx zy ny f no, the same operations as the CPU; %s is y, A or M
+static const char *_translateAluFormats[64] = {
+    [0x2A] = "0",
+    [0x3F] = "1",
+    [0x3A] = "-1",
+    [0x0C] = "d",
+    [0x30] = "%s",
+    [0x0D] = "~d",
+    [0x31] = "~%s",
+    [0x0F] = "-d",
+    [0x33] = "-%s",
+    [0x1F] = "d + 1",
+    [0x37] = "%s + 1",
+    [0x0E] = "d - 1",
+    [0x32] = "%s - 1",
+    [0x02] = "d + %s",
+    [0x13] = "d - %s",
+    [0x07] = "%s - d",
+    [0x00] = "d & %s",
+    [0x15] = "d | %s"};
+
+// Indexed by the jump bits, 0 and 7 take no condition
+static const char *_translateConditions[8] = {NULL, "out > 0", "out == 0", "out >= 0", "out < 0", "out != 0", "out <= 0", NULL};
+
+typedef struct
+{
+    unsigned char *targets; // Addresses that get a label for the direct jumps
+    int hasPrefix;
+    int hasC;
+    int hasJump;
+    int usesRam;
+} TranslateProgram_t;
+
+static void _Translate_scan(TranslateProgram_t *program, const unsigned short *words, size_t count);
+static void _Translate_header(FILE *f, const TranslateProgram_t *program, const char *source, size_t count);
+static void _Translate_word(FILE *f, const TranslateProgram_t *program, const unsigned short *words, size_t count, size_t i);
+static void _Translate_trailer(FILE *f, const TranslateProgram_t *program, size_t count);
+static void _Translate_fallThrough(FILE *f, size_t count, size_t i);
+static int _Translate_directTarget(const unsigned short *words, size_t count, size_t i);
+static void _Translate_expression(char *buffer, unsigned int c, const char *y);
+
+int TranslateWriteC(const char *filename, const char *source, const unsigned short *words, size_t count)
+{
+    TranslateProgram_t program;
+    size_t i;
+    FILE *f;
+    int r;
+
+    memset(&program, 0, sizeof(program));
+    if ((program.targets = (unsigned char *)calloc(count + 1, 1)) == NULL)
+        return TRANSLATE_ERROR_NO_MEMORY;
+    if ((f = fopen(filename, "w")) == NULL)
+    {
+        free(program.targets);
+        return TRANSLATE_ERROR_CANNOT_OPEN;
+    }
+
+    _Translate_scan(&program, words, count);
+    _Translate_header(f, &program, source, count);
+    for (i = 0; i < count; i += 1)
+        _Translate_word(f, &program, words, count, i);
+    _Translate_trailer(f, &program, count);
+
+    r = ferror(f);
+    free(program.targets);
+    if ((fclose(f) | r) != 0)
+        return TRANSLATE_ERROR_CANNOT_WRITE;
+    return 0;
+}
+
+// ================================
+
+static void _Translate_scan(TranslateProgram_t *program, const unsigned short *words, size_t count)
+{
+    unsigned int word, c;
+    size_t i;
+    int target;
+
+    for (i = 0; i < count; i += 1)
+    {
+        word = words[i];
+        if (!(word & 0x8000))
+            continue;
+        if (!(word & 0x4000))
+        {
+            program->hasPrefix = 1;
+            continue;
+        }
+        c = (word >> 6) & 0x3F;
+        program->hasC = 1;
+        if ((word & 7) != 0)
+            program->hasJump = 1;
+        if ((word & 0x0008) || ((word & 0x1000) && (_translateAluFormats[c] == NULL || strstr(_translateAluFormats[c], "%s") != NULL)))
+            program->usesRam = 1;
+        if ((target = _Translate_directTarget(words, count, i)) >= 0)
+            program->targets[target] = 1;
+    }
+}
+
+static void _Translate_header(FILE *f, const TranslateProgram_t *program, const char *source, size_t count)
+{
+    int stop;
+
+    fprintf(f, "/* Hack program '%s', %lu word(s), translated by the assembler with --emit-c. */\n", source, (unsigned long)count);
+    fprintf(f, "/* Usage: simulator [cycles], prints the report of --run. */\n\n");
+    fprintf(f, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+    fprintf(f, "#define RAM_SIZE %d\n", CPU_RAM_SIZE);
+    fprintf(f, "#define STEP(n) if (cycles == limit) { pc = (n); goto cycleLimit; } cycles += 1\n\n");
+    fprintf(f, "static short ram[RAM_SIZE];\nstatic const char *stops[] = {");
+    for (stop = CPU_STOP_HALTED; stop <= CPU_STOP_CYCLE_LIMIT; stop += 1)
+        fprintf(f, "%s\"%s\"", (stop == CPU_STOP_HALTED) ? "" : ", ", CpuStopName(stop));
+    fprintf(f, "};\n\n");
+
+    fprintf(f, "int main(int argc, char **argv)\n{\n");
+    fprintf(f, "    unsigned long limit = (argc > 1) ? strtoul(argv[1], NULL, 10) : %luUL;\n", CPU_DEFAULT_CYCLES);
+    fprintf(f, "    unsigned long cycles = 0;\n");
+    fprintf(f, "    unsigned int pc = 0, a = 0, i;\n");
+    if (program->hasJump)
+        fprintf(f, "    unsigned int target = 0;\n");
+    if (program->hasPrefix)
+        fprintf(f, "    unsigned int high = 0;\n");
+    fprintf(f, "    int d = 0, stop = %d;\n", CPU_STOP_CYCLE_LIMIT);
+    if (program->hasC)
+        fprintf(f, "    int out = 0;\n");
+    fprintf(f, "\n");
+
+    if (count == 0)
+        return;
+    if (program->hasJump)
+        fprintf(f, "dispatch:\n");
+    fprintf(f, "    switch (pc)\n    {\n");
+    if (program->hasJump)
+        fprintf(f, "    default:\n        stop = %d;\n        goto done;\n", CPU_STOP_END_OF_ROM);
+}
+
+static void _Translate_word(FILE *f, const TranslateProgram_t *program, const unsigned short *words, size_t count, size_t i)
+{
+    char expression[_TRANSLATE_EXPRESSION_LENGTH];
+    const char *y, *condition;
+    unsigned int word, c, dest, jump;
+    int target, halt, readsM;
+
+    word = words[i];
+    fprintf(f, "    case %lu: /* 0x%04X */\n", (unsigned long)i, word);
+    if (program->targets[i])
+        fprintf(f, "    L%lu:\n", (unsigned long)i);
+    fprintf(f, "        STEP(%lu);\n", (unsigned long)i);
+    if (!(word & 0x8000))
+    {
+        if (program->hasPrefix)
+            fprintf(f, "        a = (high << 15) | %uu;\n        high = 0;\n", word);
+        else
+            fprintf(f, "        a = %uu;\n", word);
+        _Translate_fallThrough(f, count, i);
+        return;
+    }
+    if (!(word & 0x4000))
+    {
+        fprintf(f, "        high = %uu;\n", word & 0x3FFF);
+        _Translate_fallThrough(f, count, i);
+        return;
+    }
+
+    // Same order as the CPU: M is written and the jump taken with the old A
+    c = (word >> 6) & 0x3F;
+    dest = (word >> 3) & 7;
+    jump = word & 7;
+    readsM = (word & 0x1000) && (_translateAluFormats[c] == NULL || strstr(_translateAluFormats[c], "%s") != NULL);
+    y = (word & 0x1000) ? "ram[a]" : "(short)a";
+    if (readsM || (dest & 1))
+        fprintf(f, "        if (a >= RAM_SIZE) { pc = %lu; goto badAddress; }\n", (unsigned long)i);
+    _Translate_expression(expression, c, y);
+    fprintf(f, "        out = (short)(%s);\n", expression);
+    if (jump)
+        fprintf(f, "        target = a;\n");
+    if (dest & 1)
+        fprintf(f, "        ram[a] = (short)out;\n");
+    if (dest & 4)
+        fprintf(f, "        a = (unsigned short)out;\n");
+    if (dest & 2)
+        fprintf(f, "        d = out;\n");
+    if (!jump)
+    {
+        _Translate_fallThrough(f, count, i);
+        return;
+    }
+
+    condition = _translateConditions[jump];
+    if (condition != NULL)
+        fprintf(f, "        if (%s)\n        {\n", condition);
+    else
+        fprintf(f, "        {\n");
+    if ((halt = CpuHaltAddress(words, i)) >= 0)
+        fprintf(f, "            if (target == %du) { pc = target; stop = %d; goto done; }\n", halt, CPU_STOP_HALTED);
+    else if ((target = _Translate_directTarget(words, count, i)) >= 0)
+        fprintf(f, "            if (target == %du) goto L%d;\n", target, target);
+    fprintf(f, "            pc = target;\n            goto dispatch;\n        }\n");
+    if (condition != NULL)
+        _Translate_fallThrough(f, count, i);
+}
+
+static void _Translate_trailer(FILE *f, const TranslateProgram_t *program, size_t count)
+{
+    if (count > 0)
+        fprintf(f, "    }\n");
+    // Off the end of the ROM, which takes no cycle but still stops at the limit
+    fprintf(f, "    pc = %luu;\n", (unsigned long)count);
+    fprintf(f, "    if (cycles == limit)\n        goto cycleLimit;\n");
+    fprintf(f, "    stop = %d;\n    goto done;\n\n", CPU_STOP_END_OF_ROM);
+    if (program->usesRam)
+        fprintf(f, "badAddress:\n    stop = %d;\n    goto done;\n", CPU_STOP_BAD_ADDRESS);
+    fprintf(f, "cycleLimit:\n    stop = %d;\n", CPU_STOP_CYCLE_LIMIT);
+    fprintf(f, "done:\n");
+    fprintf(f, "    printf(\"cycles %%lu\\nstop %%s\\nPC %%u\\nA %%u\\nD %%d\\n\", cycles, stops[stop], pc, a, d);\n");
+    fprintf(f, "    for (i = 0; i < RAM_SIZE; i += 1)\n");
+    fprintf(f, "        if (ram[i])\n            printf(\"RAM %%u %%d\\n\", i, ram[i]);\n");
+    fprintf(f, "    return 0;\n}\n");
+}
+
+/* Marks the fall into the next case, so that the simulator builds without warnings. */
+static void _Translate_fallThrough(FILE *f, size_t count, size_t i)
+{
+    if (i + 1 < count)
+        fprintf(f, "        /* fall through */\n");
+}
+
+/* The address of the "@X" right before a jump, when X is in the ROM; -1 otherwise. */
+static int _Translate_directTarget(const unsigned short *words, size_t count, size_t i)
+{
+    unsigned int word;
+
+    word = words[i];
+    if ((word & 0xC000) != 0xC000 || (word & 7) == 0 || i == 0 || (words[i - 1] & 0x8000) || words[i - 1] >= count)
+        return -1;
+    if (CpuHaltAddress(words, i) >= 0)
+        return -1; // Halts instead
+    return (int)words[i - 1];
+}
+
+/* Outside the 18 operations of the specification the ALU bits are spelled out. */
+static void _Translate_expression(char *buffer, unsigned int c, const char *y)
+{
+    char x[16], yBits[16];
+
+    if (_translateAluFormats[c] != NULL)
+    {
+        snprintf(buffer, _TRANSLATE_EXPRESSION_LENGTH, _translateAluFormats[c], y);
+        return;
+    }
+    snprintf(x, sizeof(x), "%s%s", (c & 0x10) ? "~" : "", (c & 0x20) ? "0" : "d");
+    snprintf(yBits, sizeof(yBits), "%s%s", (c & 0x04) ? "~" : "", (c & 0x08) ? "0" : y);
+    snprintf(buffer, _TRANSLATE_EXPRESSION_LENGTH, "%s(%s %c %s)", (c & 0x01) ? "~" : "", x, (c & 0x02) ? '+' : '&', yBits);
+}
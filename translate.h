@@ -0,0 +1,25 @@
+#ifndef _TRANSLATE_H_LOADED
+#define _TRANSLATE_H_LOADED
+
+#include <stddef.h>
+
+/*
+    Ahead-of-time translation of an assembled program into a C simulator, --emit-c.
+
+    The generated file is a complete program: one case per ROM address inside a
+    switch on the PC, consecutive words falling through to each other. Every
+    C-instruction gets an ALU expression specialized from its comp bits and only
+    the dest and jump code it needs. A jump whose A was loaded by the word just
+    before it tests that value first and jumps straight to the case.
+
+    The simulator takes the cycle limit as its only argument and prints the same
+    report as --run (cpu.h): it stops at the same cycle with the same PC, A, D and RAM.
+*/
+
+int TranslateWriteC(const char *filename, const char *source, const unsigned short *words, size_t count);
+
+#define TRANSLATE_ERROR_CANNOT_OPEN 1
+#define TRANSLATE_ERROR_CANNOT_WRITE 2
+#define TRANSLATE_ERROR_NO_MEMORY 3
+
+#endif